@@ -0,0 +1,65 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace Ehbanana {
+namespace Bench {
+
+// Results of the measured code are folded in so it is not optimized away
+extern volatile uint64_t sink;
+
+// Directory of the shipped configuration, mime.types and cache.xml
+extern const std::string CONFIG_DIRECTORY;
+
+/**
+ * @brief Time an operation, repeated until it ran for at least 200ms
+ *
+ * @tparam Operation_t callable, returns a value to fold into the sink
+ * @param operation to time
+ * @return double nanoseconds per call
+ */
+template <typename Operation_t> double measure(Operation_t operation) {
+  typedef std::chrono::steady_clock Clock_t;
+  const Clock_t::duration           MINIMUM = std::chrono::milliseconds(200);
+
+  uint64_t          iterations = 1;
+  Clock_t::duration elapsed;
+  for (;;) {
+    Clock_t::time_point start = Clock_t::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+      sink = sink + static_cast<uint64_t>(operation());
+    elapsed = Clock_t::now() - start;
+    if (elapsed >= MINIMUM)
+      break;
+    iterations *= 2;
+  }
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         static_cast<double>(iterations);
+}
+
+/**
+ * @brief Print a result line, the time and the rate of calls
+ *
+ * @param name of the case
+ * @param nanoseconds per call
+ * @param unit of a call, i.e. "lookup"
+ */
+inline void report(
+    const std::string & name, double nanoseconds, const char * unit) {
+  printf("  %-36s %14.1f ns/%-8s %12.0f %s/s\n", name.c_str(),
+      nanoseconds, unit, 1e9 / nanoseconds, unit);
+}
+
+void benchFrame();
+void benchRequest();
+void benchFile();
+void benchMIMETypes();
+
+} // namespace Bench
+} // namespace Ehbanana
+
+#endif /* _BENCH_H_ */
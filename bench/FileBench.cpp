@@ -0,0 +1,197 @@
+#include "Bench.h"
+
+#include <MemoryMapped.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace Ehbanana {
+namespace Bench {
+
+#ifdef __linux__
+namespace {
+
+/**
+ * @brief Connect a pair of TCP sockets over the loopback
+ *
+ * @param sender to return
+ * @param receiver to return
+ * @return true if connected
+ * @return false otherwise
+ */
+bool connectLoopback(int & sender, int & receiver) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener == -1)
+    return false;
+  struct sockaddr_in address = {};
+  address.sin_family         = AF_INET;
+  address.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+  socklen_t length           = sizeof(address);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address), length) != 0 ||
+      listen(listener, 1) != 0 ||
+      getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) !=
+          0) {
+    ::close(listener);
+    return false;
+  }
+  sender = socket(AF_INET, SOCK_STREAM, 0);
+  if (sender == -1 ||
+      connect(sender, reinterpret_cast<sockaddr *>(&address), length) != 0) {
+    ::close(listener);
+    return false;
+  }
+  receiver = accept(listener, nullptr, nullptr);
+  ::close(listener);
+  return receiver != -1;
+}
+
+/**
+ * @brief Send a buffer the way the mapped path does, a copy into the socket
+ *
+ * @param socket to send to
+ * @param data to send
+ * @param size of data
+ * @return size_t bytes sent
+ */
+size_t sendMapped(int socket, const uint8_t * data, size_t size) {
+  size_t length = 0;
+  while (length < size) {
+    ssize_t sent = send(socket, data + length, size - length, 0);
+    if (sent > 0)
+      length += static_cast<size_t>(sent);
+    else if (errno != EINTR)
+      break;
+  }
+  return length;
+}
+
+/**
+ * @brief Send a file the way the sendfile path does, from the page cache
+ *
+ * @param socket to send to
+ * @param fd of the file
+ * @param size of the file
+ * @return size_t bytes sent
+ */
+size_t sendFile(int socket, int fd, size_t size) {
+  off_t  position = 0;
+  size_t length   = 0;
+  while (length < size) {
+    ssize_t sent = sendfile(socket, fd, &position, size - length);
+    if (sent > 0)
+      length += static_cast<size_t>(sent);
+    else if (sent == 0 || errno != EINTR)
+      break;
+  }
+  return length;
+}
+
+/**
+ * @brief Get the CPU time of the calling thread
+ *
+ * @return double nanoseconds
+ */
+double threadTime() {
+  struct timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return static_cast<double>(time.tv_sec) * 1e9 +
+         static_cast<double>(time.tv_nsec);
+}
+
+} // namespace
+#endif
+
+/**
+ * @brief Throughput of multi-megabyte assets over a loopback TCP connection:
+ * sent from their mapping against sendfile from their descriptor, in wall
+ * time and in CPU time of the sending thread
+ * The files are freshly written so both read from a warm page cache
+ *
+ */
+void benchFile() {
+#ifdef __linux__
+  const size_t MEGABYTE = 1024 * 1024;
+  const size_t SIZES[]  = {4 * MEGABYTE, 16 * MEGABYTE, 64 * MEGABYTE};
+
+  int sender   = -1;
+  int receiver = -1;
+  if (!connectLoopback(sender, receiver)) {
+    printf("  Could not connect over the loopback: %d\n", errno);
+    return;
+  }
+  std::thread drain([receiver]() {
+    static uint8_t buffer[256 * 1024];
+    while (recv(receiver, buffer, sizeof(buffer), 0) > 0)
+      ;
+  });
+
+  for (size_t size : SIZES) {
+    char fileName[] = "/tmp/Ehbanana-Bench-XXXXXX";
+    int  fd         = mkstemp(fileName);
+    if (fd == -1) {
+      printf("  Could not create \"%s\": %d\n", fileName, errno);
+      break;
+    }
+    std::string block(MEGABYTE, 'x');
+    for (size_t i = 0; i < size; i += MEGABYTE) {
+      if (::write(fd, block.data(), block.size()) !=
+          static_cast<ssize_t>(block.size()))
+        printf("  Could not write \"%s\": %d\n", fileName, errno);
+    }
+
+    MemoryMapped file(fileName, 0, MemoryMapped::SequentialScan);
+    if (file.isValid() && file.size() == size) {
+      double      megabytes = static_cast<double>(size) / MEGABYTE;
+      std::string name      = std::to_string(size / MEGABYTE) + " MB, ";
+
+      // The sending thread's CPU is what sendfile saves, the loopback copies
+      // on the receiving side either way
+      double cpu   = 0;
+      double calls = 0;
+      double wall  = measure([&]() {
+        double start  = threadTime();
+        size_t length = sendMapped(sender, file.getData(), size);
+        cpu += threadTime() - start;
+        ++calls;
+        return length;
+      });
+      report(name + "mapped", wall / megabytes, "MB");
+      report(name + "mapped, sender CPU", cpu / calls / megabytes, "MB");
+
+      cpu   = 0;
+      calls = 0;
+      wall  = measure([&]() {
+        double start  = threadTime();
+        size_t length = sendFile(sender, fd, size);
+        cpu += threadTime() - start;
+        ++calls;
+        return length;
+      });
+      report(name + "sendfile", wall / megabytes, "MB");
+      report(name + "sendfile, sender CPU", cpu / calls / megabytes, "MB");
+    } else
+      printf("  Could not map \"%s\"\n", fileName);
+    file.close();
+    ::close(fd);
+    unlink(fileName);
+  }
+
+  shutdown(sender, SHUT_WR);
+  drain.join();
+  ::close(sender);
+  ::close(receiver);
+#else
+  printf("  sendfile is only used on Linux\n");
+#endif
+}
+
+} // namespace Bench
+} // namespace Ehbanana
@@ -0,0 +1,102 @@
+#include "Bench.h"
+
+#include "web/WebSocket/Frame.h"
+
+#include <list>
+#include <vector>
+
+namespace Ehbanana {
+namespace Bench {
+
+using Web::WebSocket::EncodedFramePtr_t;
+using Web::WebSocket::Frame;
+using Web::WebSocket::Opcode_t;
+
+namespace {
+
+/**
+ * @brief The outgoing frame each connection built before frames were shared
+ * The message is copied in, then copied again a byte at a time on transmit
+ *
+ */
+struct LegacyFrame_t {
+  Opcode_t    opcode = Opcode_t::TEXT;
+  std::string data;
+  std::string buffer;
+
+  /**
+   * @brief Convert the frame into a buffer byte stream
+   *
+   * @return const std::string& buffer
+   */
+  const std::string & toBuffer() {
+    buffer.push_back(static_cast<char>(0x80 | static_cast<uint8_t>(opcode)));
+    uint64_t payloadLength = data.length();
+    if (payloadLength < 126) {
+      buffer.push_back(static_cast<char>(payloadLength));
+    } else if (payloadLength <= 0xFFFF) {
+      buffer.push_back(126);
+      buffer.push_back(static_cast<char>((payloadLength >> 8) & 0xFF));
+      buffer.push_back(static_cast<char>((payloadLength >> 0) & 0xFF));
+    } else {
+      buffer.push_back(127);
+      for (int shift = 56; shift >= 0; shift -= 8)
+        buffer.push_back(static_cast<char>((payloadLength >> shift) & 0xFF));
+    }
+    for (char c : data)
+      buffer.push_back(c);
+    return buffer;
+  }
+};
+
+} // namespace
+
+/**
+ * @brief Cost of one update sent to every viewer, each queueing the frame,
+ * transmitting it and releasing it: a frame per connection against one
+ * encoded frame shared by all of them
+ *
+ */
+void benchFrame() {
+  const size_t PAYLOAD_SIZES[] = {256, 64 * 1024};
+  const size_t VIEWERS[]       = {1, 10, 100, 1000};
+
+  for (size_t payloadSize : PAYLOAD_SIZES) {
+    const std::string payload(payloadSize, 'x');
+    for (size_t viewers : VIEWERS) {
+      std::vector<std::list<LegacyFrame_t *>> legacyQueues(viewers);
+      double legacy = measure([&]() {
+        size_t written = 0;
+        for (std::list<LegacyFrame_t *> & queue : legacyQueues) {
+          LegacyFrame_t * frame = new LegacyFrame_t();
+          frame->data += payload;
+          queue.push_back(frame);
+          written += queue.front()->toBuffer().size();
+          delete queue.front();
+          queue.pop_front();
+        }
+        return written;
+      });
+
+      std::vector<std::list<EncodedFramePtr_t>> queues(viewers);
+      double shared = measure([&]() {
+        EncodedFramePtr_t frame   = Frame::encode(Opcode_t::TEXT, payload);
+        size_t            written = 0;
+        for (std::list<EncodedFramePtr_t> & queue : queues) {
+          queue.push_back(frame);
+          written += queue.front()->buffer.size();
+          queue.pop_front();
+        }
+        return written;
+      });
+
+      std::string name = std::to_string(payloadSize) + " B to " +
+                         std::to_string(viewers) + " viewers, ";
+      report(name + "frame each", legacy, "update");
+      report(name + "shared frame", shared, "update");
+    }
+  }
+}
+
+} // namespace Bench
+} // namespace Ehbanana
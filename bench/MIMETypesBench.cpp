@@ -0,0 +1,143 @@
+#include "Bench.h"
+
+#include "web/HTTP/MIMETypes.h"
+
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+
+namespace Ehbanana {
+namespace Bench {
+
+namespace {
+
+/**
+ * @brief The lookup MIMETypes replaced, kept to compare against
+ * Sixteen lists by the last nibble of the extension's hash, a mutex around
+ * each lookup to count usage and the lists sorted by usage every 100 lookups
+ *
+ */
+class LegacyMIMETypes {
+public:
+  /**
+   * @brief Populate the lists from a file, one type per line: .htm text/html
+   *
+   * @param fileName to parse
+   * @return true if the file was read
+   * @return false otherwise
+   */
+  bool populateList(const std::string & fileName) {
+    std::ifstream file(fileName);
+    std::string   line;
+    while (std::getline(file, line)) {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      size_t space = line.find(' ');
+      if (space == std::string::npos)
+        continue;
+      HashValue_t hash = Hash::calculateHash(line.substr(0, space));
+      typeBuckets[hash & 0xF].push_back({hash, line.substr(space + 1), 0});
+    }
+    sortList();
+    return !typeBuckets[0].empty();
+  }
+
+  /**
+   * @brief Get the MIME type of the file name
+   *
+   * @param fileName to parse
+   * @return const std::string& MIME type
+   */
+  const std::string & getType(const std::string & fileName) {
+    std::string fileExtension;
+    bool        dotPresent = false;
+    for (char c : fileName) {
+      if (c == '/') {
+        fileExtension.erase();
+        dotPresent = false;
+      } else if (c == '.') {
+        fileExtension = ".";
+        dotPresent    = true;
+      } else if (dotPresent)
+        fileExtension += c;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    sortTimer--;
+    if (sortTimer == 0) {
+      sortTimer = SORT_TIMER_RESET;
+      sortList();
+    }
+
+    HashValue_t hash = Hash::calculateHash(fileExtension);
+    for (Type_t & type : typeBuckets[(hash & 0xF)]) {
+      if (type.fileExtension == hash) {
+        ++type.usage;
+        return type.type;
+      }
+    }
+    return UNKNOWN_MIME_TYPE;
+  }
+
+private:
+  struct Type_t {
+    HashValue_t fileExtension;
+    std::string type;
+    uint32_t    usage;
+
+    bool operator>(const Type_t & that) const { return usage > that.usage; }
+  };
+
+  /**
+   * @brief Sort each bucket to place the most used types at the top
+   *
+   */
+  void sortList() {
+    for (std::list<Type_t> & typeBucket : typeBuckets)
+      typeBucket.sort(std::greater<Type_t>());
+  }
+
+  const uint32_t    SORT_TIMER_RESET  = 100;
+  const std::string UNKNOWN_MIME_TYPE = "application/octet-stream";
+
+  uint32_t          sortTimer = SORT_TIMER_RESET;
+  std::mutex        mutex;
+  std::list<Type_t> typeBuckets[16];
+};
+
+} // namespace
+
+/**
+ * @brief Compare the bucket lists with the open-addressing table, for the
+ * URIs of a typical page against the shipped mime.types
+ *
+ */
+void benchMIMETypes() {
+  const std::string FILE_NAME = CONFIG_DIRECTORY + "/mime.types";
+  const std::string URIS[]    = {"/index.html", "/css/style.css",
+      "/js/app.min.js", "/img/logo.png", "/img/photo.JPG", "/fonts/text.woff2",
+      "/data/points.json", "/favicon.ico"};
+
+  LegacyMIMETypes      legacy;
+  Web::HTTP::MIMETypes types;
+  if (!legacy.populateList(FILE_NAME) || !types.populateList(FILE_NAME)) {
+    printf("  Could not load \"%s\"\n", FILE_NAME.c_str());
+    return;
+  }
+
+  size_t i = 0;
+  report("bucket lists",
+      measure([&]() {
+        return legacy.getType(URIS[i++ & 7]).size();
+      }),
+      "lookup");
+  report("open-addressing table",
+      measure([&]() {
+        return types.getType(URIS[i++ & 7]).size();
+      }),
+      "lookup");
+}
+
+} // namespace Bench
+} // namespace Ehbanana
@@ -0,0 +1,244 @@
+#include "Bench.h"
+
+#include "web/HTTP/Request.h"
+#include "web/HTTP/Router.h"
+
+namespace Ehbanana {
+namespace Bench {
+
+using Web::HTTP::HeaderHash_t;
+using Web::HTTP::Request;
+using Web::HTTP::RequestHeaders;
+using Web::HTTP::Router;
+
+namespace {
+
+/**
+ * @brief The request parser replaced by the line parser, kept to compare
+ * against
+ * A state machine fed one character at a time, every token built a
+ * character at a time and the body appended a character at a time
+ *
+ */
+class LegacyRequest {
+public:
+  /**
+   * @brief Parse a string and add its contents to the request
+   *
+   * @param begin character pointer
+   * @param end character pointer
+   * @return Result error code
+   */
+  Result parse(const uint8_t * begin, const uint8_t * end) {
+    Result result;
+    while (begin != end) {
+      result = parse(*begin);
+      if (!result)
+        return result;
+      ++begin;
+    }
+    if (state == State_t::BODY && headers.getContentLength() == body.size())
+      return ResultCode_t::SUCCESS;
+    return ResultCode_t::INCOMPLETE;
+  }
+
+private:
+  /**
+   * @brief Parse a single character into the request
+   *
+   * @param c character to parse
+   * @return Result error code
+   */
+  Result parse(uint8_t c) {
+    switch (state) {
+      case State_t::IDLE:
+        state = State_t::METHOD;
+        // Fall through
+      case State_t::METHOD:
+        if (c == ' ') {
+          state = State_t::URI;
+          if (method.get() != Hash::calculateHash("GET") &&
+              method.get() != Hash::calculateHash("POST"))
+            return ResultCode_t::NOT_SUPPORTED;
+        } else
+          method.add(static_cast<char>(c));
+        break;
+      case State_t::URI:
+        if (c == ' ' || c == '?') {
+          state = c == ' ' ? State_t::HTTP_VERSION : State_t::QUERY_NAME;
+          decodeURI(uri);
+        } else
+          uri.add(static_cast<char>(c));
+        break;
+      case State_t::QUERY_NAME: {
+        if (queries.empty() || queryDone) {
+          queries.push_back(HeaderHash_t());
+          queryDone = false;
+        }
+        HeaderHash_t & query = queries.back();
+        if (c == '=' || c == ' ') {
+          state = c == '=' ? State_t::QUERY_VALUE : State_t::HTTP_VERSION;
+          decodeURI(query.name);
+        } else
+          query.name.add(static_cast<char>(c));
+      } break;
+      case State_t::QUERY_VALUE: {
+        HeaderHash_t & query = queries.back();
+        if (c == ' ' || c == '&') {
+          state = c == ' ' ? State_t::HTTP_VERSION : State_t::QUERY_NAME;
+          decodeURI(query.value);
+          queryDone = true;
+        } else
+          query.value.add(static_cast<char>(c));
+      } break;
+      case State_t::HTTP_VERSION:
+        if (c == '\n') {
+          state = State_t::HEADER_NAME;
+          if (httpVersion.get() != Hash::calculateHash("HTTP/1.0") &&
+              httpVersion.get() != Hash::calculateHash("HTTP/1.1"))
+            return ResultCode_t::NOT_SUPPORTED;
+        } else if (c != '\r')
+          httpVersion.add(static_cast<char>(c));
+        break;
+      case State_t::HEADER_NAME:
+        if (c == '\r')
+          state = State_t::BODY_NEWLINE;
+        else if (c == ' ')
+          state = State_t::HEADER_VALUE;
+        else if (c != ':')
+          currentHeader.name.add(static_cast<char>(c));
+        break;
+      case State_t::HEADER_VALUE:
+        if (c == '\n') {
+          state         = State_t::HEADER_NAME;
+          Result result = headers.addHeader(currentHeader);
+          if (!result && result != ResultCode_t::UNKNOWN_HASH)
+            return result;
+          currentHeader = HeaderHash_t();
+        } else if (c != '\r')
+          currentHeader.value.add(static_cast<char>(c));
+        break;
+      case State_t::BODY_NEWLINE:
+        if (c != '\n')
+          return ResultCode_t::BAD_COMMAND;
+        state = State_t::BODY;
+        body.reserve(headers.getContentLength());
+        break;
+      case State_t::BODY:
+        body += static_cast<char>(c);
+        break;
+    }
+    return ResultCode_t::SUCCESS;
+  }
+
+  /**
+   * @brief Decode a URI, turning escapes into their characters
+   *
+   * @param uriHash to read and overwrite
+   */
+  static void decodeURI(Hash & uriHash) {
+    const std::string & string = uriHash.getString();
+    Hash                uriDecoded;
+    for (size_t i = 0; i < string.length(); ++i) {
+      if (string[i] == '%' && i + 2 < string.length()) {
+        uriDecoded.add(static_cast<char>(
+            std::stoul(string.substr(i + 1, 2), nullptr, 16)));
+        i += 2;
+      } else
+        uriDecoded.add(string[i] == '+' ? ' ' : string[i]);
+    }
+    uriHash = uriDecoded;
+  }
+
+  enum class State_t : uint8_t {
+    IDLE,
+    METHOD,
+    URI,
+    QUERY_NAME,
+    QUERY_VALUE,
+    HTTP_VERSION,
+    HEADER_NAME,
+    HEADER_VALUE,
+    BODY_NEWLINE,
+    BODY
+  };
+
+  State_t state = State_t::IDLE;
+
+  Hash method;
+  Hash uri;
+  Hash httpVersion;
+
+  HeaderHash_t              currentHeader;
+  std::vector<HeaderHash_t> queries;
+  bool                      queryDone = false;
+
+  std::string    body;
+  RequestHeaders headers;
+};
+
+} // namespace
+
+/**
+ * @brief Requests per second of the line parser against the character
+ * parser, for a browser's GET arriving in one read and in 64 B reads
+ *
+ */
+void benchRequest() {
+  const std::string REQUEST =
+      "GET /app/view.html?tab=settings&page=2 HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "Connection: keep-alive\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+      "(KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+      "image/avif,image/webp,*/*;q=0.8\r\n"
+      "Sec-Fetch-Site: same-origin\r\n"
+      "Sec-Fetch-Mode: navigate\r\n"
+      "Sec-Fetch-User: ?1\r\n"
+      "Referer: http://localhost:8080/index.html\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Accept-Language: en-US,en;q=0.9\r\n"
+      "Cache-Control: max-age=0\r\n"
+      "\r\n";
+  const size_t READ_SIZES[] = {REQUEST.size(), 64};
+
+  const uint8_t * data = reinterpret_cast<const uint8_t *>(REQUEST.data());
+  const uint8_t * end  = data + REQUEST.size();
+  Router          router;
+  for (size_t readSize : READ_SIZES) {
+    double legacy = measure([&]() {
+      LegacyRequest request;
+      Result        result;
+      for (const uint8_t * begin = data; begin != end;) {
+        const uint8_t * readEnd =
+            begin + std::min(readSize, size_t(end - begin));
+        result = request.parse(begin, readEnd);
+        begin  = readEnd;
+      }
+      return static_cast<uint64_t>(result.getCode());
+    });
+
+    double line = measure([&]() {
+      Request request(&router);
+      Result  result;
+      for (const uint8_t * begin = data; begin != end;) {
+        const uint8_t * readEnd =
+            begin + std::min(readSize, size_t(end - begin));
+        result = request.parse(begin, readEnd);
+        begin  = readEnd;
+      }
+      return static_cast<uint64_t>(result.getCode());
+    });
+
+    std::string name = readSize == REQUEST.size()
+                           ? std::string("one read, ")
+                           : std::to_string(readSize) + " B reads, ";
+    report(name + "character parser", legacy, "request");
+    report(name + "line parser", line, "request");
+  }
+}
+
+} // namespace Bench
+} // namespace Ehbanana
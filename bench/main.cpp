@@ -0,0 +1,61 @@
+#include "Bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace Ehbanana {
+namespace Bench {
+
+volatile uint64_t sink = 0;
+
+const std::string CONFIG_DIRECTORY = EHBANANA_BENCH_CONFIG;
+
+} // namespace Bench
+} // namespace Ehbanana
+
+using namespace Ehbanana::Bench;
+
+struct Benchmark_t {
+  const char * name;
+  void (*run)();
+};
+
+static const Benchmark_t BENCHMARKS[] = {
+    {"frame", benchFrame},
+    {"request", benchRequest},
+    {"file", benchFile},
+    {"mime", benchMIMETypes},
+};
+
+/**
+ * @brief Run the benchmarks named on the command line, all without arguments
+ *
+ * @param argc count of arguments
+ * @param argv names of the benchmarks
+ * @return int EXIT_SUCCESS, EXIT_FAILURE for an unknown name
+ */
+int main(int argc, char * argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    bool found = false;
+    for (const Benchmark_t & benchmark : BENCHMARKS)
+      found = found || strcmp(argv[i], benchmark.name) == 0;
+    if (!found) {
+      printf("Unknown benchmark \"%s\", one of:", argv[i]);
+      for (const Benchmark_t & benchmark : BENCHMARKS)
+        printf(" %s", benchmark.name);
+      printf("\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (const Benchmark_t & benchmark : BENCHMARKS) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc; ++i)
+      selected = selected || strcmp(argv[i], benchmark.name) == 0;
+    if (!selected)
+      continue;
+    printf("%s\n", benchmark.name);
+    benchmark.run();
+  }
+  return EXIT_SUCCESS;
+}
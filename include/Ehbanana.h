@@ -3,6 +3,8 @@
 
 #include <FruitBowl.h>
 
+#include <stdio.h>
+
 #ifdef EB_USE_STD_STRING
 #include <string>
 #endif
@@ -11,21 +13,37 @@
 #undef GetObject
 #endif
 
+#ifdef _WIN32
+#define EHBANANA_CALLBACK __stdcall
 #ifdef COMPILING_DLL
 #define EHBANANA_API __declspec(dllexport)
 #else
 #define EHBANANA_API __declspec(dllimport)
 #endif
+#else
+#define EHBANANA_CALLBACK
+#define EHBANANA_API __attribute__((visibility("default")))
+#endif
 
 struct EBGUI;
 typedef EBGUI * EBGUI_t;
 
 enum class EBMSGType_t : uint8_t {
-  NONE,     // There is no message
-  STARTUP,  // The web server has started up
-  SHUTDOWN, // The web server is about to shutdown
-  QUIT,     // The web server has quit
-  INPUT,    // An input element has changed
+  NONE,      // There is no message
+  STARTUP,   // The web server has started up
+  SHUTDOWN,  // The web server is about to shutdown
+  QUIT,      // The web server has quit
+  INPUT,     // An input element has changed
+  CONGESTED, // A connection's send queue has exceeded its budget, id is its
+             // endpoint
+  DRAINED,   // A congested connection's send queue has emptied, id is its
+             // endpoint
+};
+
+enum class EBSendPolicy_t : uint8_t {
+  DROP_OLDEST, // Drop the oldest queued messages
+  COALESCE,    // Replace queued messages updating the same properties
+  DISCONNECT,  // Close the connection
 };
 
 /**
@@ -34,7 +52,8 @@ enum class EBMSGType_t : uint8_t {
  * @param gui object to alert
  * @param type of the message
  * @param href URL of the webpage sender or receiver
- * @param id of the originating html element
+ * @param id of the originating html element, the endpoint of the connection
+ * for CONGESTED and DRAINED
  * @param value of the originating html element
  * @param file handle when element is a file
  * @param fileSize if handle is valid
@@ -56,7 +75,45 @@ struct EBMessage_t {
  * @param msg to process
  * @return ResultCode_t error code
  */
-typedef ResultCode_t(__stdcall * EBGUIProcess_t)(const EBMessage_t &);
+typedef ResultCode_t(EHBANANA_CALLBACK * EBGUIProcess_t)(
+    const EBMessage_t &);
+
+struct EBStream;
+typedef EBStream * EBStream_t;
+
+/**
+ * @brief Produce the next part of an HTTP response to a routed request
+ * Called on a server thread each time the previous part has been sent, so
+ * only one part is held in memory. Each call must write or finish. A response
+ * finished in the first call is sent whole, else it is streamed: chunked to
+ * HTTP/1.1 clients, ended by closing the connection for HTTP/1.0 clients
+ *
+ * Return ResultCode_t::INCOMPLETE to be called again
+ * Return ResultCode_t::SUCCESS when the response is complete
+ * Any other code from the first call replies with an error status, from a
+ * later call aborts the response and closes its connection
+ *
+ * @param stream to write into
+ * @return ResultCode_t error code
+ */
+typedef ResultCode_t(EHBANANA_CALLBACK * EBStreamProcess_t)(EBStream_t);
+
+/**
+ * @brief Receive a fragment of the body of a routed request as it arrives
+ * Called on a server thread in order, before the stream's process. The body
+ * is not buffered by the server
+ *
+ * Return ResultCode_t::SUCCESS to receive the next fragment
+ * Any other code discards the rest of the body and replies with an error
+ * status
+ *
+ * @param stream of the request
+ * @param data of the fragment
+ * @param length of data
+ * @return ResultCode_t error code
+ */
+typedef ResultCode_t(EHBANANA_CALLBACK * EBBodyProcess_t)(
+    EBStream_t, const void * data, size_t length);
 
 /**
  * @brief GUI settings
@@ -64,19 +121,61 @@ typedef ResultCode_t(__stdcall * EBGUIProcess_t)(const EBMessage_t &);
  * @param guiProcess callback for incoming messages
  * @param configRoot directory containing configuration files
  * @param httpRoot directory containing HTTP top level
+ * @param httpAddress http server will bind to, nullptr for 127.0.0.1
  * @param httpPort http server will attempt to open to
  * @param timeoutIdle in seconds to wait before exiting when no connections are
  * in progress (allows time for browser to load new pages)
  * @param timeoutFirstConnect in seconds to wait before exiting when the first
  * connection is in progress (allows time for browser to boot)
+ * @param timeoutKeepAlive in seconds a persistent HTTP connection is kept open
+ * while idle, advertised in the Keep-Alive header
+ * @param ioThreads number of threads serving connections, each with its own
+ * set of connections, 0 for one per hardware thread
+ * @param sendBudgetBytes each connection may queue before its sendPolicy
+ * applies, 0 for no limit
+ * @param sendBudgetFrames each connection may queue before its sendPolicy
+ * applies, 0 for no limit
+ * @param sendPolicy when a connection exceeds its send budget, coalescing falls
+ * back to dropping the oldest when still over budget
+ * @param writeBudgetBytes each connection gathers from its queue into a single
+ * write, a larger message is written alone
+ * @param assetCacheBytes of static files kept in memory with their headers,
+ * least recently used are evicted first, 0 disables the cache
+ * @param largeFileBytes smallest static file sent from the file itself, with
+ * sendfile on Linux, instead of being copied into memory
+ * @param compressMinBytes smallest response to gzip, smaller ones are faster
+ * to send as is
+ * @param bodyMaxBytes largest request body accepted, larger ones are answered
+ * with 413 Payload Too Large before they are read
+ * @param bodyMemoryBytes of a request body or multipart field kept in memory,
+ * larger ones are spilled to a temporary file
+ * @param compress responses for clients that accept gzip, cached assets are
+ * compressed in the background, generated replies on the worker serving them,
+ * requires building with zlib
+ * @param headless server for remote browsers, EBShowGUI does not launch a
+ * browser and the server does not shutdown when idle
  */
 struct EBGUISettings_t {
   EBGUIProcess_t guiProcess = nullptr;
   char *         configRoot;
   char *         httpRoot;
+  char *         httpAddress         = nullptr;
   uint16_t       httpPort            = 0;
   uint8_t        timeoutIdle         = 2;
   uint8_t        timeoutFirstConnect = 20;
+  uint8_t        timeoutKeepAlive    = 5;
+  uint8_t        ioThreads           = 1;
+  uint32_t       sendBudgetBytes     = 1 << 20;
+  uint16_t       sendBudgetFrames    = 256;
+  EBSendPolicy_t sendPolicy          = EBSendPolicy_t::DROP_OLDEST;
+  uint32_t       writeBudgetBytes    = 64 * 1024;
+  uint32_t       assetCacheBytes     = 32 << 20;
+  uint32_t       largeFileBytes      = 1 << 20;
+  uint32_t       compressMinBytes    = 1024;
+  uint32_t       bodyMaxBytes        = 16 << 20;
+  uint32_t       bodyMemoryBytes     = 1 << 20;
+  bool           compress            = true;
+  bool           headless            = false;
 };
 
 namespace Ehbanana {
@@ -113,6 +212,7 @@ extern "C" EHBANANA_API ResultCode_t EBCreateGUI(
 
 /**
  * @brief Show the GUI by opening the preferred then default browser
+ * Does nothing if the GUI is headless
  *
  * @param gui to open
  * @return ResultCode_t error code
@@ -129,6 +229,7 @@ extern "C" EHBANANA_API ResultCode_t EBDestroyGUI(EBGUI_t gui);
 
 /**
  * @brief Get the next message in the queue
+ * Messages must be taken from a single thread, with this or EBWaitMessage
  *
  * Returns ResultCode_tCode_t::SUCCESS when the message type is QUIT
  * Returns ResultCode_tCode_t::NO_OPERATION when the queue is empty
@@ -140,6 +241,39 @@ extern "C" EHBANANA_API ResultCode_t EBDestroyGUI(EBGUI_t gui);
  */
 extern "C" EHBANANA_API ResultCode_t EBGetMessage(EBMessage_t & msg);
 
+/**
+ * @brief Get the next message in the queue, waiting for one to arrive if the
+ * queue is empty. The calling thread sleeps while waiting
+ *
+ * Returns ResultCode_tCode_t::SUCCESS when the message type is QUIT
+ * Returns ResultCode_tCode_t::NO_OPERATION when no message arrived in time
+ * Returns ResultCode_tCode_t::INCOMPLETE when the message type is not quit and
+ * no other errors occurred
+ *
+ * @param msg to write into
+ * @param timeout in milliseconds to wait for a message
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBWaitMessage(
+    EBMessage_t & msg, uint32_t timeout);
+
+/**
+ * @brief Get up to max messages from the queue in one operation, the messages
+ * are moved into msgs. Stops after a QUIT message, which is then the last
+ *
+ * Returns ResultCode_tCode_t::SUCCESS when the last message type is QUIT
+ * Returns ResultCode_tCode_t::NO_OPERATION when the queue is empty
+ * Returns ResultCode_tCode_t::INCOMPLETE when no message type is quit and no
+ * other errors occurred
+ *
+ * @param msgs array of at least max messages to write into
+ * @param max number of messages to get
+ * @param count of messages written
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBGetMessages(
+    EBMessage_t * msgs, size_t max, size_t * count);
+
 /**
  * @brief Send the message to the appropriate consumers
  *
@@ -149,7 +283,20 @@ extern "C" EHBANANA_API ResultCode_t EBGetMessage(EBMessage_t & msg);
 extern "C" EHBANANA_API ResultCode_t EBDispatchMessage(const EBMessage_t & msg);
 
 /**
- * @brief Add a message to the queue
+ * @brief Send the messages to the appropriate consumers in order
+ * QUIT messages are not dispatched, every other message is dispatched even if
+ * a previous one failed
+ *
+ * @param msgs to dispatch
+ * @param count of messages
+ * @return ResultCode_t error code of the last failed message
+ */
+extern "C" EHBANANA_API ResultCode_t EBDispatchMessages(
+    const EBMessage_t * msgs, size_t count);
+
+/**
+ * @brief Add a message to the queue, safe to call from any thread
+ * Never drops the message, the queue grows while the application falls behind
  *
  * @param msg to add
  * @param ResultCode_t error code
@@ -277,12 +424,200 @@ inline ResultCode_t EBMessageOutSetProp(EBGUI_t gui, const std::string id,
 
 /**
  * @brief Enqueue the current outgoing message for the GUI
+ * Never blocks, returns ResultCode_t::BUFFER_OVERFLOW if every output queue
+ * of the server is full and the message was dropped. Viewers behind a full
+ * queue miss the message even on success, do not retry it
  *
  * @param gui to enqueue the message for
  * @return ResultCode_t
  */
 extern "C" EHBANANA_API ResultCode_t EBMessageOutEnqueue(EBGUI_t gui);
 
+/**
+ * @brief Serve requests of a method whose URI starts with a prefix
+ * The longest matching prefix is served, requests without a route fall
+ * through to the files of the http root. Each GUI serves its own routes
+ *
+ * @param gui to serve the route from
+ * @param method of the requests: "GET", "POST", "PUT" or "DELETE"
+ * @param prefix of the URIs, absolute, i.e. "/api/"
+ * @param process to produce the responses
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBRegisterRoute(EBGUI_t gui,
+    const char * method, const char * prefix, EBStreamProcess_t process);
+
+#ifdef EB_USE_STD_STRING
+inline ResultCode_t EBRegisterRoute(EBGUI_t gui, const std::string method,
+    const std::string prefix, EBStreamProcess_t process) {
+  return EBRegisterRoute(gui, method.c_str(), prefix.c_str(), process);
+}
+#endif
+
+/**
+ * @brief Serve requests of a method whose URI starts with a prefix, receiving
+ * their bodies as they arrive instead of buffering them
+ *
+ * @param gui to serve the route from
+ * @param method of the requests: "GET", "POST", "PUT" or "DELETE"
+ * @param prefix of the URIs, absolute, i.e. "/upload/"
+ * @param process to produce the responses
+ * @param bodyProcess to receive the bodies
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBRegisterBodyRoute(EBGUI_t gui,
+    const char * method, const char * prefix, EBStreamProcess_t process,
+    EBBodyProcess_t bodyProcess);
+
+#ifdef EB_USE_STD_STRING
+inline ResultCode_t EBRegisterBodyRoute(EBGUI_t gui, const std::string method,
+    const std::string prefix, EBStreamProcess_t process,
+    EBBodyProcess_t bodyProcess) {
+  return EBRegisterBodyRoute(
+      gui, method.c_str(), prefix.c_str(), process, bodyProcess);
+}
+#endif
+
+/**
+ * @brief Serve GET requests of exactly a URI with a process
+ * Preferred over a prefix route of the same URI
+ *
+ * @param gui to serve the stream from
+ * @param uri absolute path to serve, without queries
+ * @param process to produce the response
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBRegisterStream(
+    EBGUI_t gui, const char * uri, EBStreamProcess_t process);
+
+#ifdef EB_USE_STD_STRING
+inline ResultCode_t EBRegisterStream(
+    EBGUI_t gui, const std::string uri, EBStreamProcess_t process) {
+  return EBRegisterStream(gui, uri.c_str(), process);
+}
+#endif
+
+/**
+ * @brief Write bytes to a stream, only from within its process
+ * The bytes are sent as one chunk once the process returns
+ *
+ * @param stream to write to
+ * @param data to write
+ * @param length of data
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBStreamWrite(
+    EBStream_t stream, const void * data, size_t length);
+
+#ifdef EB_USE_STD_STRING
+inline ResultCode_t EBStreamWrite(EBStream_t stream, const std::string data) {
+  return EBStreamWrite(stream, data.c_str(), data.size());
+}
+#endif
+
+/**
+ * @brief Add a header to the response of a stream, only from within the
+ * first call of its process, i.e. "Content-Type"
+ *
+ * @param stream to add the header to
+ * @param name of the header
+ * @param value of the header
+ * @return ResultCode_t error code
+ */
+extern "C" EHBANANA_API ResultCode_t EBStreamSetHeader(
+    EBStream_t stream, const char * name, const char * value);
+
+#ifdef EB_USE_STD_STRING
+inline ResultCode_t EBStreamSetHeader(
+    EBStream_t stream, const std::string name, const std::string value) {
+  return EBStreamSetHeader(stream, name.c_str(), value.c_str());
+}
+#endif
+
+/**
+ * @brief Get the value of a query of the stream's request
+ *
+ * @param stream to get the query of
+ * @param name of the query
+ * @return const char * value, nullptr if the query is not present
+ */
+extern "C" EHBANANA_API const char * EBStreamGetQuery(
+    EBStream_t stream, const char * name);
+
+/**
+ * @brief Get the URI of the stream's request, without queries
+ *
+ * @param stream to get the URI of
+ * @return const char * URI
+ */
+extern "C" EHBANANA_API const char * EBStreamGetURI(EBStream_t stream);
+
+/**
+ * @brief Get the body of the stream's request, i.e. a POST's form
+ *
+ * @param stream to get the body of
+ * @param length of the body to return
+ * @return const char * body, not null terminated, nullptr if the body is
+ * multipart, spilled to a file or received by a body process
+ */
+extern "C" EHBANANA_API const char * EBStreamGetBody(
+    EBStream_t stream, size_t * length);
+
+/**
+ * @brief Get the body of the stream's request once spilled to a temporary
+ * file, larger than bodyMemoryBytes
+ *
+ * @param stream to get the body of
+ * @param size of the body to return
+ * @return FILE * body, rewound, closed with the stream, nullptr if the body is
+ * in memory
+ */
+extern "C" EHBANANA_API FILE * EBStreamGetBodyFile(
+    EBStream_t stream, size_t * size);
+
+/**
+ * @brief Get the value of a field of the stream's multipart/form-data body
+ *
+ * @param stream to get the field of
+ * @param name of the field
+ * @return const char * value, nullptr if the field is not present, is a file
+ * or was spilled to a file
+ */
+extern "C" EHBANANA_API const char * EBStreamGetField(
+    EBStream_t stream, const char * name);
+
+/**
+ * @brief Get a file of the stream's multipart/form-data body
+ * Uploaded files are written to temporary files as they arrive
+ *
+ * @param stream to get the file of
+ * @param name of the field
+ * @param size of the file to return
+ * @param fileName the client gave the file to return, may be empty
+ * @return FILE * file, rewound, closed with the stream, nullptr if the field
+ * is not present or is in memory
+ */
+extern "C" EHBANANA_API FILE * EBStreamGetFile(EBStream_t stream,
+    const char * name, size_t * size, const char ** fileName);
+
+/**
+ * @brief Get the cursor of a stream, kept between calls of its process
+ * i.e. the next row to export, starts at 0
+ *
+ * @param stream to get the cursor of
+ * @return uint64_t cursor
+ */
+extern "C" EHBANANA_API uint64_t EBStreamGetCursor(EBStream_t stream);
+
+/**
+ * @brief Set the cursor of a stream, kept between calls of its process
+ *
+ * @param stream to set the cursor of
+ * @param cursor to set
+ */
+extern "C" EHBANANA_API void EBStreamSetCursor(
+    EBStream_t stream, uint64_t cursor);
+
 enum class EBLogLevel_t : uint8_t {
   EB_DEBUG,
   EB_INFO,
@@ -298,7 +633,7 @@ enum class EBLogLevel_t : uint8_t {
  * @param EBLogLevel_t log level
  * @param char * string
  */
-typedef void(__stdcall * EBLogger_t)(
+typedef void(EHBANANA_CALLBACK * EBLogger_t)(
     const EBLogLevel_t level, const char * string);
 
 /**
@@ -3,6 +3,9 @@
 
 #include <Ehbanana.h>
 
+#include <stdexcept>
+#include <string>
+
 namespace Ehbanana {
 
 /**
@@ -65,7 +68,7 @@ protected:
     if (!result) {
       result = result + "EBMessageOutCreate";
       if (throwOnError)
-        throw std::exception(result.getMessage());
+        throw std::runtime_error(result.getMessage());
       return result;
     }
 
@@ -73,7 +76,7 @@ protected:
     if (!result) {
       result = result + "EBMessageOutSetHref";
       if (throwOnError)
-        throw std::exception(result.getMessage());
+        throw std::runtime_error(result.getMessage());
       return result;
     }
     return ResultCode_t::SUCCESS;
@@ -90,7 +93,7 @@ protected:
     if (!result) {
       result = result + "EBMessageOutEnqueue";
       if (throwOnError)
-        throw std::exception(result.getMessage());
+        throw std::runtime_error(result.getMessage());
       return result;
     }
     return ResultCode_t::SUCCESS;
@@ -112,7 +115,7 @@ protected:
     if (!result) {
       result = result + "EBMessageOutSetProp";
       if (throwOnError)
-        throw std::exception(result.getMessage());
+        throw std::runtime_error(result.getMessage());
       return result;
     }
     return ResultCode_t::SUCCESS;
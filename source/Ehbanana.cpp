@@ -2,29 +2,117 @@
 
 #include "EhbananaLog.h"
 #include "MessageOut.h"
+#include "web/HTTP/Stream.h"
+#include "web/MPSCRing.h"
 #include "web/Server.h"
 
 #include <FruitBowl.h>
-#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
-#include <list>
+#include <mutex>
 #include <stdlib.h>
 #include <string>
 
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+
+extern char ** environ;
+#endif
+
 namespace Ehbanana {
 
-static std::list<EBMessage_t> MessageQueue;
-static Result                 lastResult;
+static const size_t MESSAGE_QUEUE_SIZE = 4096;
+
+// Messages are enqueued from the server's worker threads, consumed by the
+// application's thread. The mutex only serves to park a waiting consumer
+static Web::MPSCRing<EBMessage_t> MessageQueue(MESSAGE_QUEUE_SIZE);
+static std::mutex                 MessageQueueMutex;
+static std::condition_variable    MessageQueueCondition;
+static std::atomic<bool>          MessageQueueWaiting {false};
+static Result                     lastResult;
+
+// Messages that did not fit in the ring wait in order in the overflow, never
+// dropped. The consumer moves them to its backlog, served before the ring
+static std::deque<EBMessage_t> MessageOverflow;
+static std::mutex              MessageOverflowMutex;
+static std::atomic<bool>       MessageOverflowPending {false};
+static std::deque<EBMessage_t> MessageBacklog;
+
+/**
+ * @brief Pop the oldest message, only call from the consumer thread
+ *
+ * @param msg to write into
+ * @return true if a message was popped
+ * @return false if the queue is empty
+ */
+static bool popMessage(EBMessage_t & msg) {
+  if (MessageBacklog.empty()) {
+    if (MessageQueue.pop(msg))
+      return true;
+    if (!MessageOverflowPending.load())
+      return false;
+    std::lock_guard<std::mutex> lock(MessageOverflowMutex);
+    MessageBacklog.swap(MessageOverflow);
+    MessageOverflowPending = false;
+    if (MessageBacklog.empty())
+      return false;
+  }
+  msg = MessageBacklog.front();
+  MessageBacklog.pop_front();
+  return true;
+}
+
+/**
+ * @brief Push a message, safe to call from any thread
+ * Once the ring is full messages go to the overflow until the consumer takes
+ * it, keeping each producer's messages in order
+ *
+ * @param msg to push
+ */
+static void pushMessage(const EBMessage_t & msg) {
+  if (!MessageOverflowPending.load()) {
+    EBMessage_t copy = msg;
+    if (MessageQueue.push(std::move(copy)))
+      return;
+  }
+  std::lock_guard<std::mutex> lock(MessageOverflowMutex);
+  if (MessageOverflow.empty())
+    warn("Message queue is full, application is falling behind");
+  MessageOverflow.push_back(msg);
+  MessageOverflowPending = true;
+}
+
+/**
+ * @brief Handle a message popped from the queue before the application does
+ *
+ * @param msg popped
+ * @return ResultCode_t error code, see EBGetMessage
+ */
+static ResultCode_t processMessage(EBMessage_t & msg) {
+  if (msg.type == EBMSGType_t::QUIT) {
+    msg.gui->server->stop();
+    return ResultCode_t::SUCCESS;
+  }
+  return ResultCode_t::INCOMPLETE;
+}
 
 } // namespace Ehbanana
 
+#ifdef _WIN32
 /**
  * @brief Create a process from the command string
  *
  * @param command string to execute
  * @return Result error code
  */
-
 Result EBCreateProcess(
     const std::string & command, PROCESS_INFORMATION * process) {
   STARTUPINFOA startupInfo;
@@ -42,6 +130,30 @@ Result EBCreateProcess(
   delete buf;
   return ResultCode_t::SUCCESS;
 }
+#else
+/**
+ * @brief Create a process from the command arguments
+ * The process is reaped in the background once it exits
+ *
+ * @param args to execute, the first is the program searched for in the PATH
+ * @return Result error code
+ */
+Result EBCreateProcess(const std::vector<std::string> & args) {
+  std::vector<char *> argv;
+  for (const std::string & arg : args)
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+      0) {
+    Ehbanana::error("Failed to create process \"" + args[0] + "\"");
+    return ResultCode_t::BAD_COMMAND + ("Create process: " + args[0]);
+  }
+  std::thread([pid]() { waitpid(pid, nullptr, 0); }).detach();
+  return ResultCode_t::SUCCESS;
+}
+#endif
 
 ResultCode_t EBCreateGUI(EBGUISettings_t guiSettings, EBGUI_t & gui) {
   // Construct a new EBGUI object to store settings and the server
@@ -52,6 +164,8 @@ ResultCode_t EBCreateGUI(EBGUISettings_t guiSettings, EBGUI_t & gui) {
     return result.getCode();
   }
   gui = new EBGUI();
+  // Set before starting the server, connections read the settings
+  gui->settings = guiSettings;
 
   if (guiSettings.guiProcess == nullptr) {
     delete gui;
@@ -60,8 +174,9 @@ ResultCode_t EBCreateGUI(EBGUISettings_t guiSettings, EBGUI_t & gui) {
   }
 
   // Construct a new server and attach it to the EBGUI
-  gui->server = new Ehbanana::Web::Server(
-      gui, guiSettings.timeoutIdle, guiSettings.timeoutFirstConnect);
+  gui->server = new Ehbanana::Web::Server(gui, guiSettings.timeoutIdle,
+      guiSettings.timeoutFirstConnect, guiSettings.ioThreads,
+      !guiSettings.headless);
   result = gui->server->configure(guiSettings.httpRoot, guiSettings.configRoot);
   if (!result) {
     if (result == ResultCode_t::OPEN_FAILED) {
@@ -82,7 +197,10 @@ ResultCode_t EBCreateGUI(EBGUISettings_t guiSettings, EBGUI_t & gui) {
     }
   }
 
-  result = gui->server->initializeSocket("127.0.0.1", guiSettings.httpPort);
+  std::string address = "127.0.0.1";
+  if (guiSettings.httpAddress != nullptr)
+    address = guiSettings.httpAddress;
+  result = gui->server->initializeSocket(address, guiSettings.httpPort);
   if (!result) {
     delete gui->server;
     delete gui;
@@ -100,11 +218,18 @@ ResultCode_t EBCreateGUI(EBGUISettings_t guiSettings, EBGUI_t & gui) {
     return result.getCode();
   }
 
-  gui->settings = guiSettings;
   return ResultCode_t::SUCCESS;
 }
 
 ResultCode_t EBShowGUI(EBGUI_t gui) {
+  std::string URL = "http://";
+  URL += gui->server->getDomainName();
+
+  if (gui->settings.headless) {
+    Ehbanana::info("Headless GUI served at " + URL);
+    return ResultCode_t::SUCCESS;
+  }
+
   // Ensure system calls is available
   if (!std::system(nullptr)) {
     Ehbanana::error(
@@ -112,15 +237,11 @@ ResultCode_t EBShowGUI(EBGUI_t gui) {
     return ResultCode_t::NO_SYSTEM_CALL;
   }
 
+#ifdef _WIN32
   PROCESS_INFORMATION browser;
 
-  std::string URL = "http://";
-  URL += gui->server->getDomainName();
-
-  std::string command = "--app=\"" + URL + "\"";
-
   // Try Chrome default install location first
-  command =
+  std::string command =
       "\"C:\\Program Files (x86)\\Google\\Chrome\\Application\\chrome.exe\"";
   command += " --app=\"" + URL + "\"";
   if (!EBCreateProcess(command, &browser)) {
@@ -145,6 +266,27 @@ ResultCode_t EBShowGUI(EBGUI_t gui) {
   WaitForSingleObject(browser.hProcess, 1000);
   CloseHandle(browser.hProcess);
   CloseHandle(browser.hThread);
+#else
+  // Try Chrome then Chromium as an app first
+  if (!EBCreateProcess({"google-chrome", "--app=" + URL})) {
+    Ehbanana::warn("Chrome not found in PATH");
+    if (!EBCreateProcess({"chromium", "--app=" + URL})) {
+      Ehbanana::warn("Chromium not found in PATH");
+      // Use default browser last
+#ifdef __APPLE__
+      Result result = EBCreateProcess({"open", URL});
+#else
+      Result result = EBCreateProcess({"xdg-open", URL});
+#endif
+      if (!result) {
+        Ehbanana::error(
+            (ResultCode_t::OPEN_FAILED + "Failed to start a web browser")
+                .getMessage());
+        return ResultCode_t::NO_SYSTEM_CALL;
+      }
+    }
+  }
+#endif
 
   Ehbanana::info("Web browser opened to " + URL);
 
@@ -159,16 +301,46 @@ ResultCode_t EBDestroyGUI(EBGUI_t gui) {
 }
 
 ResultCode_t EBGetMessage(EBMessage_t & msg) {
-  if (Ehbanana::MessageQueue.empty()) {
+  if (!Ehbanana::popMessage(msg)) {
     msg.type = EBMSGType_t::NONE;
     return ResultCode_t::NO_OPERATION;
   }
-  msg = Ehbanana::MessageQueue.front();
-  Ehbanana::MessageQueue.pop_front();
-  if (msg.type == EBMSGType_t::QUIT) {
-    msg.gui->server->stop();
-    return ResultCode_t::SUCCESS;
+  return Ehbanana::processMessage(msg);
+}
+
+ResultCode_t EBWaitMessage(EBMessage_t & msg, uint32_t timeout) {
+  if (Ehbanana::popMessage(msg))
+    return Ehbanana::processMessage(msg);
+
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  bool popped;
+  {
+    std::unique_lock<std::mutex> lock(Ehbanana::MessageQueueMutex);
+    Ehbanana::MessageQueueWaiting.store(true, std::memory_order_relaxed);
+    // Pairs with the fence in EBEnqueueMessage, either the producer sees the
+    // waiting flag or the predicate sees the message
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    popped = Ehbanana::MessageQueueCondition.wait_until(lock, deadline,
+        [&msg]() { return Ehbanana::popMessage(msg); });
+    Ehbanana::MessageQueueWaiting.store(false, std::memory_order_relaxed);
+  }
+  if (!popped) {
+    msg.type = EBMSGType_t::NONE;
+    return ResultCode_t::NO_OPERATION;
   }
+  return Ehbanana::processMessage(msg);
+}
+
+ResultCode_t EBGetMessages(EBMessage_t * msgs, size_t max, size_t * count) {
+  *count = 0;
+  while (*count < max && Ehbanana::popMessage(msgs[*count])) {
+    EBMessage_t & msg = msgs[(*count)++];
+    if (msg.type == EBMSGType_t::QUIT)
+      return Ehbanana::processMessage(msg);
+  }
+  if (*count == 0)
+    return ResultCode_t::NO_OPERATION;
   return ResultCode_t::INCOMPLETE;
 }
 
@@ -181,8 +353,27 @@ ResultCode_t EBDispatchMessage(const EBMessage_t & msg) {
   return ResultCode_t::SUCCESS;
 }
 
+ResultCode_t EBDispatchMessages(const EBMessage_t * msgs, size_t count) {
+  ResultCode_t resultCode = ResultCode_t::SUCCESS;
+  for (size_t i = 0; i < count; ++i) {
+    if (msgs[i].type == EBMSGType_t::QUIT)
+      continue;
+    ResultCode_t msgResultCode = EBDispatchMessage(msgs[i]);
+    if (!msgResultCode)
+      resultCode = msgResultCode;
+  }
+  return resultCode;
+}
+
 ResultCode_t EBEnqueueMessage(const EBMessage_t & msg) {
-  Ehbanana::MessageQueue.push_back(msg);
+  Ehbanana::pushMessage(msg);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (Ehbanana::MessageQueueWaiting.load(std::memory_order_relaxed)) {
+    // Lock so the notification cannot land between the consumer's check and
+    // its wait
+    std::lock_guard<std::mutex> lock(Ehbanana::MessageQueueMutex);
+    Ehbanana::MessageQueueCondition.notify_one();
+  }
   return ResultCode_t::SUCCESS;
 }
 
@@ -286,13 +477,152 @@ ResultCode_t EBMessageOutEnqueue(EBGUI_t gui) {
             .getMessage());
     return ResultCode_t::INVALID_DATA;
   }
-  if (!gui->currentMessageOut->isEnqueued())
-    gui->server->enqueueOutput(gui->currentMessageOut->getString());
+  Result result = ResultCode_t::SUCCESS;
+  if (!gui->currentMessageOut->isEnqueued()) {
+    std::string targets;
+    HashValue_t key = gui->currentMessageOut->getKey(targets);
+    result = gui->server->enqueueOutput(
+        gui->currentMessageOut->getString(), key, targets);
+  }
   delete gui->currentMessageOut;
   gui->currentMessageOut = nullptr;
+  if (!result) {
+    Ehbanana::error((result + "Enqueueing message out").getMessage());
+    return result.getCode();
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+ResultCode_t EBRegisterRoute(EBGUI_t gui, const char * method,
+    const char * prefix, EBStreamProcess_t process) {
+  if (gui == nullptr || method == nullptr || prefix == nullptr) {
+    Ehbanana::error(
+        (ResultCode_t::INVALID_DATA + "Registering route to nullptr")
+            .getMessage());
+    return ResultCode_t::INVALID_DATA;
+  }
+  Result result = gui->server->getRouter().addRoute(
+      method, prefix, {process, nullptr});
+  if (!result) {
+    Ehbanana::error((result + "Registering route").getMessage());
+    return result.getCode();
+  }
   return ResultCode_t::SUCCESS;
 }
 
+ResultCode_t EBRegisterBodyRoute(EBGUI_t gui, const char * method,
+    const char * prefix, EBStreamProcess_t process,
+    EBBodyProcess_t bodyProcess) {
+  if (gui == nullptr || method == nullptr || prefix == nullptr) {
+    Ehbanana::error(
+        (ResultCode_t::INVALID_DATA + "Registering body route to nullptr")
+            .getMessage());
+    return ResultCode_t::INVALID_DATA;
+  }
+  Result result = gui->server->getRouter().addRoute(
+      method, prefix, {process, bodyProcess});
+  if (!result) {
+    Ehbanana::error((result + "Registering body route").getMessage());
+    return result.getCode();
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+ResultCode_t EBRegisterStream(
+    EBGUI_t gui, const char * uri, EBStreamProcess_t process) {
+  if (gui == nullptr || uri == nullptr) {
+    Ehbanana::error(
+        (ResultCode_t::INVALID_DATA + "Registering stream to nullptr")
+            .getMessage());
+    return ResultCode_t::INVALID_DATA;
+  }
+  Result result = gui->server->getRouter().addRoute(
+      "GET", uri, {process, nullptr}, true);
+  if (!result) {
+    Ehbanana::error((result + "Registering stream").getMessage());
+    return result.getCode();
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+ResultCode_t EBStreamWrite(
+    EBStream_t stream, const void * data, size_t length) {
+  Result result = stream->write(data, length);
+  if (!result) {
+    Ehbanana::error((result + "Writing stream").getMessage());
+    return result.getCode();
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+ResultCode_t EBStreamSetHeader(
+    EBStream_t stream, const char * name, const char * value) {
+  Result result = stream->addHeader(name, value);
+  if (!result) {
+    Ehbanana::error((result + "Setting stream header").getMessage());
+    return result.getCode();
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+const char * EBStreamGetQuery(EBStream_t stream, const char * name) {
+  return stream->getQuery(name);
+}
+
+const char * EBStreamGetURI(EBStream_t stream) {
+  return stream->getURI().c_str();
+}
+
+const char * EBStreamGetBody(EBStream_t stream, size_t * length) {
+  const Ehbanana::Web::HTTP::BodyPart_t * part = stream->getBody().getPart();
+  if (part == nullptr || part->file != nullptr) {
+    *length = 0;
+    return nullptr;
+  }
+  *length = part->size;
+  return part->data.data();
+}
+
+FILE * EBStreamGetBodyFile(EBStream_t stream, size_t * size) {
+  const Ehbanana::Web::HTTP::BodyPart_t * part = stream->getBody().getPart();
+  if (part == nullptr || part->file == nullptr) {
+    *size = 0;
+    return nullptr;
+  }
+  *size = part->size;
+  return part->file;
+}
+
+const char * EBStreamGetField(EBStream_t stream, const char * name) {
+  const Ehbanana::Web::HTTP::BodyPart_t * part =
+      stream->getBody().getPart(name);
+  if (part == nullptr || part->file != nullptr)
+    return nullptr;
+  return part->data.c_str();
+}
+
+FILE * EBStreamGetFile(EBStream_t stream, const char * name, size_t * size,
+    const char ** fileName) {
+  const Ehbanana::Web::HTTP::BodyPart_t * part =
+      stream->getBody().getPart(name);
+  if (part == nullptr || part->file == nullptr) {
+    *size     = 0;
+    *fileName = nullptr;
+    return nullptr;
+  }
+  *size     = part->size;
+  *fileName = part->fileName.c_str();
+  return part->file;
+}
+
+uint64_t EBStreamGetCursor(EBStream_t stream) {
+  return stream->cursor;
+}
+
+void EBStreamSetCursor(EBStream_t stream, uint64_t cursor) {
+  stream->cursor = cursor;
+}
+
 void EBSetLogger(const EBLogger_t logger) {
   Ehbanana::Logger::Instance()->set(logger);
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include <rapidjson/prettywriter.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace Ehbanana {
 
 /**
@@ -166,6 +170,52 @@ const std::string & MessageOut::getString(bool updateEnqueued) {
   return buf;
 }
 
+/**
+ * @brief Get the key of the properties the message updates
+ * Messages to the same href updating the same properties have the same key
+ * and targets, regardless of the order the properties were set. The targets
+ * tell apart messages whose keys collide
+ *
+ * @param targets to return, the href and the sorted properties, each length
+ * prefixed
+ * @return HashValue_t key, never 0
+ */
+HashValue_t MessageOut::getKey(std::string & targets) const {
+  std::vector<std::pair<std::string, std::string>> properties;
+  const rapidjson::Value & elements = json["elements"];
+  for (rapidjson::Value::ConstMemberIterator element = elements.MemberBegin();
+       element != elements.MemberEnd(); ++element) {
+    for (rapidjson::Value::ConstMemberIterator property =
+             element->value.MemberBegin();
+         property != element->value.MemberEnd(); ++property) {
+      properties.emplace_back(
+          std::string(element->name.GetString(),
+              element->name.GetStringLength()),
+          std::string(property->name.GetString(),
+              property->name.GetStringLength()));
+    }
+  }
+  std::sort(properties.begin(), properties.end());
+
+  const rapidjson::Value & href = json["href"];
+  targets = std::to_string(href.GetStringLength()) + ":" +
+            std::string(href.GetString(), href.GetStringLength());
+  Hash hrefHash;
+  hrefHash.add(href.GetString());
+  HashValue_t key = hrefHash.get();
+  for (const std::pair<std::string, std::string> & property : properties) {
+    targets += std::to_string(property.first.size()) + ":" + property.first +
+               std::to_string(property.second.size()) + ":" + property.second;
+    Hash hash;
+    hash.add(property.first.c_str());
+    hash.add('.');
+    hash.add(property.second.c_str());
+    // Combined in sorted order, a sum would collide for unrelated sets
+    key ^= hash.get() + 0x9e3779b9 + (key << 6) + (key >> 2);
+  }
+  return (key == 0) ? 1 : key;
+}
+
 /**
  * @brief Check if the message has been enqueued already
  *
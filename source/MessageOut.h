@@ -4,6 +4,8 @@
 #include <FruitBowl.h>
 #include <rapidjson/document.h>
 
+#include <string>
+
 namespace Ehbanana {
 
 class MessageOut {
@@ -22,6 +24,8 @@ public:
 
   const std::string & getString(bool updateEnqueued = true);
 
+  HashValue_t getKey(std::string & targets) const;
+
   bool isEnqueued() const;
 
 private:
@@ -2,10 +2,14 @@
 #define _WEB_APP_PROTOCOL_H_
 
 #include "Ehbanana.h"
+#include "WebSocket/Frame.h"
 
 #include <FruitBowl.h>
 #include <asio.hpp>
 
+#include <chrono>
+#include <string>
+
 namespace Ehbanana {
 namespace Web {
 
@@ -95,6 +99,19 @@ public:
     return true;
   }
 
+  /**
+   * @brief Get the file a transmit buffer can be sent from without copying
+   *
+   * @param buffer in the transmit queue
+   * @param fd descriptor to return
+   * @param offset of the buffer in the file to return
+   * @return true if the buffer is backed by a file
+   * @return false if the buffer must be written from memory
+   */
+  virtual bool getTransmitFile(const asio::const_buffer &, int &, uint64_t &) {
+    return false;
+  }
+
   /**
    * @brief Get the requested protocol to change to
    *
@@ -104,6 +121,15 @@ public:
     return AppProtocol_t::NONE;
   }
 
+  /**
+   * @brief Get the time the connection may be idle before an alive check
+   *
+   * @return std::chrono::seconds timeout
+   */
+  virtual std::chrono::seconds getTimeout() {
+    return std::chrono::seconds(1);
+  }
+
   /**
    * @brief Send a check to test the connection for aliveness
    *
@@ -118,13 +144,25 @@ public:
    * @brief Add a message to transmit out if available
    * returns ResultCode_t::NOT_SUPPORTED if not compatible
    *
-   * @param msg to add
+   * @param frame encoded message to add, shared with other connections
    * @return Result
    */
-  virtual Result addMessage(const std::string &) {
+  virtual Result addMessage(WebSocket::EncodedFramePtr_t) {
     return ResultCode_t::NOT_SUPPORTED;
   }
 
+  /**
+   * @brief Take the received bytes that belong to the requested protocol
+   * i.e. a WebSocket frame that arrived right behind the upgrade request
+   *
+   * @return std::string bytes, empty if none
+   */
+  std::string takeLeftover() {
+    std::string bytes;
+    bytes.swap(leftover);
+    return bytes;
+  }
+
 protected:
   /**
    * @brief Add a buffer to the transmit queue
@@ -145,6 +183,8 @@ protected:
       buffersTransmit.push_back(buffer);
   }
 
+  std::string leftover;
+
 private:
   std::vector<asio::const_buffer> buffersTransmit;
 };
@@ -1,7 +1,15 @@
 #include "Connection.h"
 
+#include "Worker.h"
+
 #include <sstream>
 
+#ifdef __linux__
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#endif
+
 namespace Ehbanana {
 namespace Web {
 
@@ -10,20 +18,19 @@ namespace Web {
  *
  * @param socket to read from and write to
  * @param endpoint socket is connected to
- * @param now current timestamp
+ * @param worker that owns this connection
  * @param gui that owns this server
  */
-Connection::Connection(asio::ip::tcp::socket * socket, std::string endpoint,
-    const std::chrono::time_point<std::chrono::system_clock> & now,
-    EBGUI_t                                                    gui) :
-  socket(socket),
-  endpoint(endpoint), gui(gui) {
-  this->timeoutTime = now + TIMEOUT;
-
-  socket->non_blocking(true);
-
+Connection::Connection(asio::ip::tcp::socket socket,
+    const std::string & endpoint, Worker * worker, EBGUI_t gui) :
+  socket(std::move(socket)),
+  endpoint(endpoint), worker(worker), bufferReceive(RECEIVE_SIZE_MIN),
+  protocol(new HTTP::HTTP(gui)), timer([this]() { onTimeout(); }), gui(gui) {
+  asio::error_code          errorCode;
   asio::socket_base::keep_alive option(true);
-  socket->set_option(option);
+  this->socket.set_option(option, errorCode);
+  // Synchronous reads return would_block instead of waiting
+  this->socket.non_blocking(true, errorCode);
 }
 
 /**
@@ -35,94 +42,48 @@ Connection::~Connection() {
 }
 
 /**
- * @brief Update the current operation based on the protocol
- *
- * Returns ResultCode_t::INCOMPLETE if more operations are required
- * Returns ResultCode_t::NO_OPERATION if nothing happenend this update
- * Returns ResultCode_t::TIMEOUT if the connection was idle for too long
+ * @brief Start the asynchronous operations of the connection
+ * Must be called from the worker's thread once the connection is owned by a
+ * shared_ptr
  *
- * @param now current timestamp
- * @return Result error code
  */
-Result Connection::update(
-    const std::chrono::time_point<std::chrono::system_clock> & now) {
-  Result           result;
-  asio::error_code errorCode;
-  size_t           length = socket->available(errorCode);
-  if (errorCode) {
-    return ResultCode_t::READ_FAULT + errorCode.message() +
-           ("Checking available bytes for " + endpoint);
-  }
-  if (length != 0) {
-    timeoutTime = now + TIMEOUT;
-    // Bytes available to read.
-    length = socket->read_some(asio::buffer(bufferReceive), errorCode);
-    if (!errorCode) {
-      result = protocol->processReceiveBuffer(bufferReceive.data(), length);
-      if (!result)
-        return result;
-    } else
-      return ResultCode_t::READ_FAULT + errorCode.message() + endpoint;
-  }
-  if (protocol->hasTransmitBuffers()) {
-    timeoutTime = now + TIMEOUT;
-    length      = socket->write_some(protocol->getTransmitBuffers(), errorCode);
-    if (errorCode == asio::error::would_block) {
-      return ResultCode_t::INCOMPLETE;
-    } else if (!errorCode) {
-      if (protocol->updateTransmitBuffers(length)) {
-        return ResultCode_t::INCOMPLETE;
-      }
-    } else
-      return ResultCode_t::WRITE_FAULT + errorCode.message() + endpoint;
-  }
-  if (protocol->isDone()) {
-    switch (protocol->getChangeRequest()) {
-      case AppProtocol_t::HTTP:
-        delete protocol;
-        protocol = new HTTP::HTTP();
-        return ResultCode_t::INCOMPLETE;
-      case AppProtocol_t::WEBSOCKET:
-        delete protocol;
-        protocol = new WebSocket::WebSocket(gui);
-        return ResultCode_t::INCOMPLETE;
-      case AppProtocol_t::NONE:
-        return ResultCode_t::SUCCESS;
-      default:
-        return ResultCode_t::INVALID_STATE +
-               ("Connection AppProtocol change to: " +
-                   std::to_string(
-                       static_cast<uint8_t>(protocol->getChangeRequest())));
-    }
-  }
-  if (now > timeoutTime && protocol->sendAliveCheck())
-    return ResultCode_t::TIMEOUT;
-  return ResultCode_t::NO_OPERATION;
+void Connection::start() {
+  resetTimeout();
+  startRead();
 }
 
 /**
  * @brief Add a message to the protocol to transmit out if available
  * returns ResultCode_t::NOT_SUPPORTED if not compatible with the protocol
+ * Finishes the connection if the protocol fails to add the message
  *
- * @param msg to add
+ * @param frame encoded message to add, shared with other connections
  * @return Result
  */
-Result Connection::addMessage(const std::string & msg) {
-  return protocol->addMessage(msg);
+Result Connection::addMessage(WebSocket::EncodedFramePtr_t frame) {
+  if (closed)
+    return ResultCode_t::NOT_SUPPORTED + "Connection is closed";
+  Result result = protocol->addMessage(std::move(frame));
+  if (result)
+    process();
+  else if (result != ResultCode_t::NOT_SUPPORTED)
+    finish(result);
+  return result;
 }
 
 /**
  * @brief Stop the socket and free its memory
+ * Any pending operations complete with asio::error::operation_aborted
  *
  */
 void Connection::stop() {
-  if (socket != nullptr && socket->is_open()) {
-    asio::error_code errorCode;
-    socket->shutdown(asio::ip::tcp::socket::shutdown_both, errorCode);
-    socket->close(errorCode);
+  closed = true;
+  timer.cancel();
+  asio::error_code errorCode;
+  if (socket.is_open()) {
+    socket.shutdown(asio::ip::tcp::socket::shutdown_both, errorCode);
+    socket.close(errorCode);
   }
-  delete socket;
-  socket = nullptr;
   delete protocol;
   protocol = nullptr;
 }
@@ -136,5 +97,286 @@ const std::string & Connection::getEndpoint() const {
   return endpoint;
 }
 
+/**
+ * @brief Wait for bytes to be received
+ *
+ */
+void Connection::startRead() {
+  std::shared_ptr<Connection> self = shared_from_this();
+  socket.async_read_some(asio::buffer(bufferReceive),
+      [self](const asio::error_code & errorCode, size_t length) {
+        self->onRead(errorCode, length);
+      });
+}
+
+/**
+ * @brief Write the protocol's transmit buffers
+ * Only one write is in progress at a time
+ * On Linux, buffers backed by a file are sent with sendfile. The buffers
+ * ahead of one are corked so they share its first segment
+ *
+ */
+void Connection::startWrite() {
+  writing                          = true;
+  std::shared_ptr<Connection> self = shared_from_this();
+  const std::vector<asio::const_buffer> & buffers =
+      protocol->getTransmitBuffers();
+#ifdef __linux__
+  int      fd     = -1;
+  uint64_t offset = 0;
+  size_t   count  = 0;
+  while (count < buffers.size() &&
+         !protocol->getTransmitFile(buffers[count], fd, offset))
+    ++count;
+  if (count == 0) {
+    startSendFile();
+    return;
+  } else if (count < buffers.size()) {
+    std::vector<asio::const_buffer> head(
+        buffers.begin(), buffers.begin() + count);
+    socket.async_send(head, MSG_MORE,
+        [self](const asio::error_code & errorCode, size_t length) {
+          self->onWrite(errorCode, length);
+        });
+    return;
+  }
+#endif
+  asio::async_write(socket, buffers,
+      [self](const asio::error_code & errorCode, size_t length) {
+        self->onWrite(errorCode, length);
+      });
+}
+
+#ifdef __linux__
+/**
+ * @brief Wait for the socket to accept the file at the front of the transmit
+ * buffers
+ *
+ */
+void Connection::startSendFile() {
+  std::shared_ptr<Connection> self = shared_from_this();
+  socket.async_wait(asio::socket_base::wait_write,
+      [self](const asio::error_code & errorCode) {
+        self->onSendFile(errorCode);
+      });
+}
+#endif
+
+/**
+ * @brief Restart the idle timeout of the protocol from now on the worker's
+ * timer wheel
+ *
+ */
+void Connection::resetTimeout() {
+  worker->getTimerWheel().schedule(timer, protocol->getTimeout());
+}
+
+/**
+ * @brief Handle the completion of a read
+ * Passes the received bytes to the protocol then keeps reading until the
+ * socket would block or the read budget is spent, then waits for more
+ *
+ * @param errorCode of the read
+ * @param length of bytes read
+ */
+void Connection::onRead(const asio::error_code & errorCode, size_t length) {
+  if (closed)
+    return;
+  asio::error_code readErrorCode = errorCode;
+  size_t           bytesRead     = 0;
+  for (;;) {
+    if (readErrorCode == asio::error::would_block)
+      break;
+    if (readErrorCode == asio::error::eof) {
+      finish(ResultCode_t::SUCCESS);
+      return;
+    } else if (readErrorCode) {
+      finish(ResultCode_t::READ_FAULT + readErrorCode.message() + endpoint);
+      return;
+    }
+
+    if (!receive(length))
+      return;
+    bytesRead += length;
+    if (bytesRead >= READ_BUDGET)
+      break;
+    length = socket.read_some(asio::buffer(bufferReceive), readErrorCode);
+  }
+  resetTimeout();
+  startRead();
+}
+
+/**
+ * @brief Handle the completion of a write
+ * Removes the transmitted buffers then writes the next if available
+ *
+ * @param errorCode of the write
+ * @param length of bytes written
+ */
+void Connection::onWrite(const asio::error_code & errorCode, size_t length) {
+  writing = false;
+  if (closed)
+    return;
+  if (errorCode) {
+    finish(ResultCode_t::WRITE_FAULT + errorCode.message() + endpoint);
+    return;
+  }
+
+  resetTimeout();
+  protocol->updateTransmitBuffers(length);
+  process();
+}
+
+#ifdef __linux__
+/**
+ * @brief Handle the socket becoming writable for a file buffer
+ * Sends from the page cache until the socket would block or the buffer is
+ * done, the file's pages are never touched by this thread
+ *
+ * @param errorCode of the wait
+ */
+void Connection::onSendFile(const asio::error_code & errorCode) {
+  if (closed || errorCode) {
+    onWrite(errorCode, 0);
+    return;
+  }
+
+  const asio::const_buffer & buffer = protocol->getTransmitBuffers().front();
+  int                        fd     = -1;
+  uint64_t                   offset = 0;
+  protocol->getTransmitFile(buffer, fd, offset);
+  off_t  position = static_cast<off_t>(offset);
+  size_t length   = 0;
+  while (length < buffer.size()) {
+    ssize_t sent = sendfile(
+        socket.native_handle(), fd, &position, buffer.size() - length);
+    if (sent > 0)
+      length += static_cast<size_t>(sent);
+    else if (sent == 0) {
+      // The file was truncated under the reply
+      onWrite(asio::error::eof, length);
+      return;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else if (errno != EINTR) {
+      onWrite(asio::error_code(errno, asio::error::get_system_category()),
+          length);
+      return;
+    }
+  }
+  if (length == 0)
+    startSendFile();
+  else
+    onWrite(asio::error_code(), length);
+}
+#endif
+
+/**
+ * @brief Handle the expiration of the idle timeout
+ * Ask the protocol for an alive check, closing if one was already sent
+ *
+ */
+void Connection::onTimeout() {
+  if (closed)
+    return;
+  // Hold a reference, finishing removes the connection from its worker
+  std::shared_ptr<Connection> self = shared_from_this();
+  if (protocol->sendAliveCheck()) {
+    finish(ResultCode_t::TIMEOUT);
+    return;
+  }
+  resetTimeout();
+  process();
+}
+
+/**
+ * @brief Pass received bytes to the protocol and advance it
+ * Grows the receive buffer when the bytes filled it, shrinks it back once
+ * reads are small again
+ *
+ * @param length of bytes received
+ * @return true if the connection is still open
+ * @return false if the connection finished
+ */
+bool Connection::receive(size_t length) {
+  Result result = protocol->processReceiveBuffer(bufferReceive.data(), length);
+  if (!result && result != ResultCode_t::INCOMPLETE) {
+    finish(result);
+    return false;
+  }
+  process();
+  if (closed)
+    return false;
+
+  if (length == bufferReceive.size() && length < RECEIVE_SIZE_MAX)
+    bufferReceive.resize(length * 2);
+  else if (length < RECEIVE_SIZE_MIN && bufferReceive.size() > RECEIVE_SIZE_MIN)
+    std::vector<uint8_t>(RECEIVE_SIZE_MIN).swap(bufferReceive);
+  return true;
+}
+
+/**
+ * @brief Advance the protocol after an operation
+ * Writes pending transmit buffers, changes protocol when the current one is
+ * done, or finishes the connection when no protocol is requested
+ *
+ */
+void Connection::process() {
+  if (protocol->hasTransmitBuffers()) {
+    if (!writing)
+      startWrite();
+    return;
+  }
+  if (!protocol->isDone())
+    return;
+  switch (protocol->getChangeRequest()) {
+    case AppProtocol_t::HTTP:
+      delete protocol;
+      protocol = new HTTP::HTTP(gui);
+      resetTimeout();
+      break;
+    case AppProtocol_t::WEBSOCKET: {
+      // Frames may have arrived right behind the upgrade request
+      std::string leftover = protocol->takeLeftover();
+      delete protocol;
+      protocol = new WebSocket::WebSocket(gui, endpoint);
+      resetTimeout();
+      if (!leftover.empty()) {
+        Result result = protocol->processReceiveBuffer(
+            reinterpret_cast<const uint8_t *>(leftover.data()),
+            leftover.size());
+        if (!result && result != ResultCode_t::INCOMPLETE) {
+          finish(result);
+          break;
+        }
+        process();
+      }
+    } break;
+    case AppProtocol_t::NONE:
+      finish(ResultCode_t::SUCCESS);
+      break;
+    default:
+      finish(ResultCode_t::INVALID_STATE +
+             ("Connection AppProtocol change to: " +
+                 std::to_string(
+                     static_cast<uint8_t>(protocol->getChangeRequest()))));
+      break;
+  }
+}
+
+/**
+ * @brief Close the connection and remove it from the worker
+ *
+ * Result of ResultCode_t::TIMEOUT if the connection was idle for too long
+ *
+ * @param result of the connection
+ */
+void Connection::finish(Result result) {
+  if (closed)
+    return;
+  closed = true;
+  worker->removeConnection(shared_from_this(), result);
+}
+
 } // namespace Web
 } // namespace Ehbanana
\ No newline at end of file
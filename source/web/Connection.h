@@ -4,46 +4,75 @@
 #include "AppProtocol.h"
 #include "Ehbanana.h"
 #include "HTTP/HTTP.h"
+#include "TimerWheel.h"
 #include "WebSocket/WebSocket.h"
 
 #include <FruitBowl.h>
 #include <asio.hpp>
 
-#include <array>
 #include <chrono>
+#include <memory>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace Ehbanana {
 namespace Web {
 
-class Connection {
+class Worker;
+
+class Connection : public std::enable_shared_from_this<Connection> {
 public:
   Connection(const Connection &) = delete;
   Connection & operator=(const Connection &) = delete;
 
-  Connection(asio::ip::tcp::socket * socket, std::string endpoint,
-      const std::chrono::time_point<std::chrono::system_clock> & now,
-      EBGUI_t                                                    gui);
+  Connection(asio::ip::tcp::socket socket, const std::string & endpoint,
+      Worker * worker, EBGUI_t gui);
   ~Connection();
 
-  Result update(const std::chrono::time_point<std::chrono::system_clock> & now);
-  Result addMessage(const std::string & msg);
+  void   start();
+  Result addMessage(WebSocket::EncodedFramePtr_t frame);
   void   stop();
 
   const std::string & getEndpoint() const;
 
 private:
-  asio::ip::tcp::socket * socket;
-  std::string             endpoint;
-
-  std::array<uint8_t, 8192> bufferReceive;
-
-  AppProtocol * protocol = new HTTP::HTTP();
-
-  std::chrono::time_point<std::chrono::system_clock> timeoutTime;
-
-  const std::chrono::seconds TIMEOUT {1};
+  void startRead();
+  void startWrite();
+#ifdef __linux__
+  void startSendFile();
+#endif
+  void resetTimeout();
+
+  void onRead(const asio::error_code & errorCode, size_t length);
+  void onWrite(const asio::error_code & errorCode, size_t length);
+#ifdef __linux__
+  void onSendFile(const asio::error_code & errorCode);
+#endif
+  void onTimeout();
+
+  bool receive(size_t length);
+  void process();
+  void finish(Result result);
+
+  asio::ip::tcp::socket socket;
+  std::string           endpoint;
+  Worker *              worker;
+
+  // The receive buffer grows while reads fill it, e.g. during a large frame
+  static const size_t RECEIVE_SIZE_MIN = 8 * 1024;
+  static const size_t RECEIVE_SIZE_MAX = 256 * 1024;
+  // Bytes read per readiness before yielding to other connections
+  static const size_t READ_BUDGET = 1024 * 1024;
+
+  std::vector<uint8_t> bufferReceive;
+
+  AppProtocol * protocol;
+
+  TimerWheel::Timer timer;
+
+  bool writing = false;
+  bool closed  = false;
 
   EBGUI_t gui;
 };
@@ -0,0 +1,359 @@
+#include "AssetCache.h"
+
+#include "EhbananaLog.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+/**
+ * @brief Construct a new Asset Cache object
+ *
+ * @param resourceIndex of the server's http root
+ * @param compressor of the server, gzips cached assets in the background
+ */
+AssetCache::AssetCache(
+    ResourceIndex & resourceIndex, Compressor & compressor) :
+  resourceIndex(resourceIndex), compressor(compressor) {}
+
+/**
+ * @brief Set the maximum number of bytes held by the cache
+ * Evicts the least recently used assets over the new capacity
+ *
+ * @param bytes capacity, 0 disables caching
+ */
+void AssetCache::setCapacity(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  capacity = bytes;
+  evict(0);
+}
+
+/**
+ * @brief Set the smallest file sent from the file itself instead of memory
+ * On Linux it is sent with sendfile from its descriptor, elsewhere from its
+ * mapping. Cached entries keep the representation they were loaded with
+ *
+ * @param bytes threshold, 0 sends every file from the file itself
+ */
+void AssetCache::setLargeFileBytes(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  largeFileBytes = bytes;
+}
+
+/**
+ * @brief Get the asset of a URI, loading it from a file on a miss
+ * Assets that fit are kept for the next request, others are released after
+ * the reply. Large files are sent from their descriptor or mapping, which
+ * cached entries keep open between requests. The best precompressed sibling
+ * the client accepts is selected, a gzip representation is compressed in the
+ * background for cached assets without one. An entry made from a previous
+ * version of the resource is loaded again
+ *
+ * @param resource of the asset from the index, its URI is the cache key
+ * @param headers of the request, for its accepted encodings
+ * @param asset to return
+ * @return Result error code
+ */
+Result AssetCache::get(const ResourcePtr_t & resource,
+    const RequestHeaders & headers, AssetPtr_t & asset) {
+  const std::string & uri   = resource->uri;
+  size_t              limit = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        i = index.find(uri);
+    if (i != index.end() && i->second->resource != resource) {
+      // The file or its Cache-Control changed since it was cached
+      bytes -= i->second->size;
+      entries.erase(i->second);
+      index.erase(i);
+      i = index.end();
+    }
+    if (i != index.end()) {
+      ++hits;
+      // Move to the front as the most recently used
+      entries.splice(entries.begin(), entries, i->second);
+      asset = select(*i->second, headers);
+      compressLater(*i->second, headers);
+      return ResultCode_t::SUCCESS;
+    }
+    ++misses;
+    limit = largeFileBytes;
+  }
+
+  Entry_t entry;
+  Result  result = load(resource, limit, entry);
+  if (!result)
+    return result + ("Loading asset: " + uri);
+  asset = select(entry, headers);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (index.find(uri) != index.end() || entry.size > capacity)
+    return ResultCode_t::SUCCESS;
+  evict(entry.size);
+  entries.push_front(entry);
+  index[uri] = entries.begin();
+  bytes += entry.size;
+  compressLater(entries.front(), headers);
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get the number of requests served from the cache
+ *
+ * @return size_t hits
+ */
+size_t AssetCache::getHits() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return hits;
+}
+
+/**
+ * @brief Get the number of requests that loaded their file
+ *
+ * @return size_t misses
+ */
+size_t AssetCache::getMisses() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return misses;
+}
+
+/**
+ * @brief Load a file and its precompressed ".br" and ".gz" siblings
+ * Every representation varies on Accept-Encoding when a sibling exists.
+ * Siblings are found in the resource index, missing ones are not opened
+ *
+ * @param resource of the file to load
+ * @param limit smallest file sent from the file itself
+ * @param entry to populate
+ * @return Result error code
+ */
+Result AssetCache::load(
+    const ResourcePtr_t & resource, size_t limit, Entry_t & entry) {
+  entry.uri      = resource->uri;
+  entry.resource = resource;
+  ResourcePtr_t files[ENCODING_COUNT];
+  files[static_cast<size_t>(Encoding_t::BROTLI)] =
+      resourceIndex.find(resource->uri + ".br");
+  files[static_cast<size_t>(Encoding_t::GZIP)] =
+      resourceIndex.find(resource->uri + ".gz");
+  files[static_cast<size_t>(Encoding_t::IDENTITY)] = resource;
+
+  std::shared_ptr<Asset_t> assets[ENCODING_COUNT];
+  for (size_t i = 0; i < ENCODING_COUNT; ++i) {
+    if (files[i] == nullptr)
+      continue;
+    Result result = load(*files[i], limit, assets[i]);
+    // Siblings are optional, the file itself is not
+    if (!result && static_cast<Encoding_t>(i) == Encoding_t::IDENTITY)
+      return result;
+  }
+
+  // Representations vary when a sibling exists or one can be compressed
+  const Asset_t & identity =
+      *assets[static_cast<size_t>(Encoding_t::IDENTITY)];
+  bool vary = (identity.isInMemory() &&
+                  compressor.isCompressible(identity.size)) ||
+              assets[static_cast<size_t>(Encoding_t::BROTLI)] != nullptr ||
+              assets[static_cast<size_t>(Encoding_t::GZIP)] != nullptr;
+  for (size_t i = 0; i < ENCODING_COUNT; ++i) {
+    std::shared_ptr<Asset_t> & asset = assets[i];
+    if (asset == nullptr)
+      continue;
+    serializeHeaders(*resource, static_cast<Encoding_t>(i), vary, *asset);
+    entry.size += (asset->isInMemory() ? asset->size : FILE_ASSET_BYTES) +
+                  asset->headers.size();
+    entry.assets[i] = asset;
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Load one representation of an asset
+ * A file under the limit is copied. On Linux a larger one only has its
+ * descriptor opened, its body is sent with sendfile. The file is mapped
+ * instead elsewhere or if the descriptor cannot be set up
+ *
+ * @param file of the representation, its size is from the index
+ * @param limit smallest file sent from the file itself
+ * @param asset to return
+ * @return Result error code
+ */
+Result AssetCache::load(const Resource_t & file, size_t limit,
+    std::shared_ptr<Asset_t> & asset) {
+  asset = std::make_shared<Asset_t>();
+#ifdef __linux__
+  if (file.size >= limit && file.size > 0) {
+    int descriptor = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor != -1) {
+      // Reserves addresses for the body's buffers without mapping the file
+      void * reservation = mmap(nullptr, file.size, PROT_NONE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (reservation != MAP_FAILED) {
+        asset->descriptor = descriptor;
+        asset->reserved   = file.size;
+        asset->data       = static_cast<const uint8_t *>(reservation);
+        asset->size       = file.size;
+        return ResultCode_t::SUCCESS;
+      }
+      ::close(descriptor);
+    }
+  }
+#endif
+
+  MemoryMapped * mapping =
+      new MemoryMapped(file.path, 0, MemoryMapped::SequentialScan);
+  if (!mapping->isValid()) {
+    mapping->close();
+    delete mapping;
+    return ResultCode_t::OPEN_FAILED + file.path;
+  }
+
+  asset->size = static_cast<size_t>(mapping->size());
+  if (asset->size >= limit && asset->size > 0) {
+    asset->file = mapping;
+    asset->data = mapping->getData();
+  } else {
+    asset->content.assign(
+        reinterpret_cast<const char *>(mapping->getData()), asset->size);
+    asset->data = reinterpret_cast<const uint8_t *>(asset->content.data());
+    mapping->close();
+    delete mapping;
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Serialize the headers of a representation
+ * The validators are a strong ETag from the modification time, size and
+ * encoding, and the Last-Modified date. A 304 reply repeats only those
+ * and the caching headers, formatted by the resource index
+ *
+ * @param resource of the file
+ * @param encoding of the representation
+ * @param vary true adds "Vary: Accept-Encoding"
+ * @param asset to populate, its size must be set
+ */
+void AssetCache::serializeHeaders(const Resource_t & resource,
+    Encoding_t encoding, bool vary, Asset_t & asset) {
+  asset.modified = resource.modified;
+
+  std::string contentEncoding;
+  switch (encoding) {
+    case Encoding_t::BROTLI:
+      asset.etag =
+          ResourceIndex::formatETag(resource.modified, asset.size, "-br");
+      contentEncoding = "Content-Encoding: br\r\n";
+      break;
+    case Encoding_t::GZIP:
+      asset.etag =
+          ResourceIndex::formatETag(resource.modified, asset.size, "-gz");
+      contentEncoding = "Content-Encoding: gzip\r\n";
+      break;
+    case Encoding_t::IDENTITY:
+    default:
+      asset.etag = resource.etag;
+      break;
+  }
+
+  asset.headersNotModified = "ETag: " + asset.etag +
+                             "\r\nLast-Modified: " + resource.lastModified +
+                             "\r\nCache-Control: " + resource.cacheControl +
+                             "\r\n";
+  if (vary)
+    asset.headersNotModified += "Vary: Accept-Encoding\r\n";
+  asset.type    = resource.type;
+  asset.headers = "Content-Type: " + asset.type +
+                  "\r\nContent-Length: " + std::to_string(asset.size) +
+                  "\r\nAccept-Ranges: bytes\r\n" + contentEncoding +
+                  asset.headersNotModified;
+}
+
+/**
+ * @brief Queue the gzip compression of a cached asset without a gzip sibling
+ * Runs on the compressor's thread, the result is added to the entry if it
+ * was not replaced in the meantime
+ *
+ * @param entry of the asset, must be cached
+ * @param headers of the request, for its accepted encodings
+ */
+void AssetCache::compressLater(
+    Entry_t & entry, const RequestHeaders & headers) {
+  AssetPtr_t identity = entry.assets[static_cast<size_t>(Encoding_t::IDENTITY)];
+  if (entry.compressing ||
+      entry.assets[static_cast<size_t>(Encoding_t::GZIP)] != nullptr ||
+      !headers.acceptsEncoding(Encoding_t::GZIP) || !identity->isInMemory() ||
+      !compressor.isCompressible(identity->size))
+    return;
+  entry.compressing = true;
+
+  ResourcePtr_t resource = entry.resource;
+  compressor.post([this, resource, identity]() {
+    std::string content;
+    Result      result =
+        compressor.gzip(identity->data, identity->size, content);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        i = index.find(resource->uri);
+    if (i == index.end() ||
+        i->second->assets[static_cast<size_t>(Encoding_t::IDENTITY)] !=
+            identity)
+      return;
+    Entry_t & entry = *i->second;
+    // Not worth sending if it did not shrink
+    if (!result || content.size() >= identity->size)
+      return;
+
+    std::shared_ptr<Asset_t> asset = std::make_shared<Asset_t>();
+    asset->content.swap(content);
+    asset->data = reinterpret_cast<const uint8_t *>(asset->content.data());
+    asset->size = asset->content.size();
+    serializeHeaders(*resource, Encoding_t::GZIP, true, *asset);
+    size_t size = asset->size + asset->headers.size();
+    entry.assets[static_cast<size_t>(Encoding_t::GZIP)] = asset;
+    entry.size += size;
+    bytes += size;
+    evict(0);
+  });
+}
+
+/**
+ * @brief Remove the least recently used assets until there is room
+ * Replies holding an evicted asset keep it until they are written
+ *
+ * @param bytes needed for a new asset
+ */
+void AssetCache::evict(size_t bytes) {
+  while (!entries.empty() && this->bytes + bytes > capacity) {
+    const Entry_t & entry = entries.back();
+    this->bytes -= entry.size;
+    index.erase(entry.uri);
+    entries.pop_back();
+  }
+}
+
+/**
+ * @brief Select the most preferred representation the client accepts
+ * Ranges are always of the file itself
+ *
+ * @param entry of the asset
+ * @param headers of the request
+ * @return AssetPtr_t representation, identity when no sibling is accepted
+ */
+AssetPtr_t AssetCache::select(
+    const Entry_t & entry, const RequestHeaders & headers) {
+  for (size_t i = 0; i < ENCODING_COUNT && !headers.hasRange(); ++i) {
+    if (entry.assets[i] != nullptr &&
+        headers.acceptsEncoding(static_cast<Encoding_t>(i)))
+      return entry.assets[i];
+  }
+  return entry.assets[static_cast<size_t>(Encoding_t::IDENTITY)];
+}
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
\ No newline at end of file
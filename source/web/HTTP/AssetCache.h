@@ -0,0 +1,174 @@
+#ifndef _WEB_ASSET_CACHE_H_
+#define _WEB_ASSET_CACHE_H_
+
+#include "Compressor.h"
+#include "RequestHeaders.h"
+#include "ResourceIndex.h"
+
+#include <FruitBowl.h>
+#include <MemoryMapped.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+struct Asset_t {
+  Asset_t() {}
+  Asset_t(const Asset_t &) = delete;
+  Asset_t & operator=(const Asset_t &) = delete;
+
+  /**
+   * @brief Destroy the Asset_t object
+   * Close the mapping or descriptor if the asset was too large to copy
+   *
+   */
+  ~Asset_t() {
+    if (file != nullptr) {
+      file->close();
+      delete file;
+    }
+#ifdef __linux__
+    if (descriptor != -1)
+      ::close(descriptor);
+    if (reserved != 0)
+      munmap(const_cast<uint8_t *>(data), reserved);
+#endif
+  }
+
+  /**
+   * @brief Get the file a buffer of the asset can be sent from
+   *
+   * @param buffer pointing into data
+   * @param fd descriptor to return
+   * @param offset of the buffer in the file to return
+   * @return true if the buffer lies in a file that can be sent directly
+   * @return false otherwise
+   */
+  bool getFile(const void * buffer, int & fd, uint64_t & offset) const {
+    const uint8_t * begin = static_cast<const uint8_t *>(buffer);
+    if (descriptor == -1 || begin < data || begin >= data + size)
+      return false;
+    fd     = descriptor;
+    offset = static_cast<uint64_t>(begin - data);
+    return true;
+  }
+
+  // Serialized entity headers, each line ends in CRLF
+  std::string headers;
+  std::string headersNotModified;
+
+  // MIME type, repeated in each part of a multipart range reply
+  std::string type;
+
+  // Validators of a conditional request, the ETag includes its quotes
+  std::string etag;
+  time_t      modified = 0;
+
+  // Bytes of a small file, or the mapping of a large one without sendfile
+  std::string    content;
+  MemoryMapped * file = nullptr;
+
+  // Descriptor of a large file sent from the page cache with sendfile, data
+  // is then an inaccessible address range that only identifies its buffers
+  int    descriptor = -1;
+  size_t reserved   = 0;
+
+  const uint8_t * data = nullptr;
+  size_t          size = 0;
+
+  /**
+   * @brief Check if the bytes of the asset are in memory
+   *
+   * @return true if data can be read, false if the asset is sent from its file
+   */
+  bool isInMemory() const {
+    return file == nullptr && descriptor == -1;
+  }
+};
+
+typedef std::shared_ptr<const Asset_t> AssetPtr_t;
+
+// Static files of one server, with their headers, in memory
+class AssetCache {
+public:
+  AssetCache(const AssetCache &) = delete;
+  AssetCache & operator=(const AssetCache &) = delete;
+
+  AssetCache(ResourceIndex & resourceIndex, Compressor & compressor);
+
+  void setCapacity(size_t bytes);
+  void setLargeFileBytes(size_t bytes);
+
+  Result get(const ResourcePtr_t & resource, const RequestHeaders & headers,
+      AssetPtr_t & asset);
+
+  size_t getHits();
+  size_t getMisses();
+
+private:
+  typedef RequestHeaders::Encoding_t Encoding_t;
+
+  // Precompressed siblings of a file, in order of preference
+  static const size_t ENCODING_COUNT = 3;
+
+  // Weight of an asset held open as a file, bounds the descriptors cached
+  static const size_t FILE_ASSET_BYTES = 64 * 1024;
+
+  struct Entry_t {
+    std::string   uri;
+    ResourcePtr_t resource;
+    AssetPtr_t    assets[ENCODING_COUNT];
+    size_t        size        = 0;
+    bool          compressing = false;
+  };
+
+  Result load(const ResourcePtr_t & resource, size_t limit, Entry_t & entry);
+  Result load(const Resource_t & file, size_t limit,
+      std::shared_ptr<Asset_t> & asset);
+  void   evict(size_t bytes);
+  void   compressLater(Entry_t & entry, const RequestHeaders & headers);
+
+  static void serializeHeaders(const Resource_t & resource,
+      Encoding_t encoding, bool vary, Asset_t & asset);
+
+  static AssetPtr_t select(
+      const Entry_t & entry, const RequestHeaders & headers);
+
+  // Of the server, siblings are found in the index and compressed by the
+  // compressor
+  ResourceIndex & resourceIndex;
+  Compressor &    compressor;
+
+  // Workers serve assets concurrently
+  std::mutex mutex;
+
+  // Most recently used first
+  std::list<Entry_t> entries;
+
+  std::unordered_map<std::string, std::list<Entry_t>::iterator> index;
+
+  size_t capacity       = 0;
+  size_t largeFileBytes = 1 << 20;
+  size_t bytes          = 0;
+  size_t hits           = 0;
+  size_t misses         = 0;
+};
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_ASSET_CACHE_H_ */
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "Body.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+/**
+ * @brief Construct a new Body object
+ *
+ */
+Body::Body() {}
+
+/**
+ * @brief Destroy the Body object
+ * Temporary files are deleted once closed
+ *
+ */
+Body::~Body() {
+  for (BodyPart_t & part : parts) {
+    if (part.file != nullptr)
+      fclose(part.file);
+  }
+}
+
+/**
+ * @brief Prepare for the body of a request
+ * A multipart/form-data body is split into its parts as it is written
+ *
+ * @param headers of the request
+ * @return Result error code
+ */
+Result Body::open(const RequestHeaders & headers) {
+  const std::string & type = headers.getContentType();
+  const std::string   MULTIPART = "multipart/form-data";
+  if (type.compare(0, MULTIPART.size(), MULTIPART) != 0) {
+    parts.emplace_back();
+    return ResultCode_t::SUCCESS;
+  }
+
+  std::string boundary;
+  if (!getParameter(type, "boundary", boundary) || boundary.empty() ||
+      boundary.size() > 70)
+    return ResultCode_t::INVALID_DATA + ("Multipart boundary: " + type);
+  delimiter = "\r\n--" + boundary;
+  // The first delimiter may start the body, without a line ending before it
+  carry     = "\r\n";
+  state     = State_t::DATA;
+  multipart = true;
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Write a fragment of the body
+ *
+ * @param begin of the fragment
+ * @param length of the fragment
+ * @return Result error code
+ */
+Result Body::write(const uint8_t * begin, size_t length) {
+  if (state == State_t::RAW)
+    return append(parts.front(), begin, length);
+
+  const uint8_t * end = begin + length;
+  Result          result;
+  while (begin != end) {
+    switch (state) {
+      case State_t::DATA:
+        result = parseData(begin, end);
+        break;
+      case State_t::DELIMITER:
+        result = parseDelimiter(begin, end);
+        break;
+      case State_t::HEADERS:
+        result = parseHeaders(begin, end);
+        break;
+      case State_t::EPILOGUE:
+      default:
+        // Ignored
+        begin = end;
+        break;
+    }
+    if (!result)
+      return result;
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Finish the body once all of it has been written
+ * Spilled files are rewound for reading
+ *
+ * @return Result error code
+ */
+Result Body::close() {
+  if (multipart && state != State_t::EPILOGUE)
+    return ResultCode_t::INVALID_DATA + "Multipart body is not terminated";
+  for (BodyPart_t & part : parts) {
+    if (part.file != nullptr)
+      rewind(part.file);
+  }
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get the whole body
+ *
+ * @return const BodyPart_t * body, nullptr if it is multipart
+ */
+const BodyPart_t * Body::getPart() const {
+  if (multipart || parts.empty())
+    return nullptr;
+  return &parts.front();
+}
+
+/**
+ * @brief Get a part of a multipart body by its field name
+ *
+ * @param name of the field
+ * @return const BodyPart_t * part, nullptr if not found
+ */
+const BodyPart_t * Body::getPart(const std::string & name) const {
+  if (!multipart)
+    return nullptr;
+  for (const BodyPart_t & part : parts) {
+    if (part.name == name)
+      return &part;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Parse the data of a part up to its delimiter
+ * A delimiter only starts at a carriage return, the rest is found with memchr.
+ * A delimiter split between fragments is held in the carry
+ *
+ * @param begin of the fragment, advanced past the bytes consumed
+ * @param end of the fragment
+ * @return Result error code
+ */
+Result Body::parseData(const uint8_t *& begin, const uint8_t * end) {
+  const uint8_t * pattern = reinterpret_cast<const uint8_t *>(delimiter.data());
+  Result          result;
+  if (!carry.empty()) {
+    size_t length = std::min(
+        delimiter.size() - carry.size(), static_cast<size_t>(end - begin));
+    if (memcmp(begin, pattern + carry.size(), length) == 0) {
+      carry.append(begin, begin + length);
+      begin += length;
+      if (carry.size() == delimiter.size()) {
+        carry.clear();
+        inPart = false;
+        state  = State_t::DELIMITER;
+      }
+      return ResultCode_t::SUCCESS;
+    }
+    // Only the line ending starts a delimiter, the carry was data
+    result = emit(
+        reinterpret_cast<const uint8_t *>(carry.data()), carry.size());
+    carry.clear();
+    if (!result)
+      return result;
+  }
+
+  const uint8_t * search = begin;
+  for (;;) {
+    const uint8_t * found = static_cast<const uint8_t *>(
+        memchr(search, '\r', static_cast<size_t>(end - search)));
+    if (found == nullptr)
+      break;
+    size_t length =
+        std::min(delimiter.size(), static_cast<size_t>(end - found));
+    if (memcmp(found, pattern, length) != 0) {
+      search = found + 1;
+      continue;
+    }
+    result = emit(begin, static_cast<size_t>(found - begin));
+    if (!result)
+      return result;
+    if (length < delimiter.size()) {
+      carry.assign(found, end);
+      begin = end;
+    } else {
+      begin  = found + length;
+      inPart = false;
+      state  = State_t::DELIMITER;
+    }
+    return ResultCode_t::SUCCESS;
+  }
+  result = emit(begin, static_cast<size_t>(end - begin));
+  begin  = end;
+  return result;
+}
+
+/**
+ * @brief Parse the two bytes after a delimiter
+ * A line ending starts the next part, two dashes end the body
+ *
+ * @param begin of the fragment, advanced past the bytes consumed
+ * @param end of the fragment
+ * @return Result error code
+ */
+Result Body::parseDelimiter(const uint8_t *& begin, const uint8_t * end) {
+  while (begin != end && line.size() < 2)
+    line += static_cast<char>(*begin++);
+  if (line.size() < 2)
+    return ResultCode_t::SUCCESS;
+  if (line == "--") {
+    state = State_t::EPILOGUE;
+    line.clear();
+  } else if (line == "\r\n") {
+    // Kept so a part without headers ends at the first blank line
+    state = State_t::HEADERS;
+  } else
+    return ResultCode_t::INVALID_DATA + "Multipart delimiter";
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Parse the headers of a part up to the blank line
+ *
+ * @param begin of the fragment, advanced past the bytes consumed
+ * @param end of the fragment
+ * @return Result error code
+ */
+Result Body::parseHeaders(const uint8_t *& begin, const uint8_t * end) {
+  // The blank line may be split between fragments
+  size_t search = line.size() < 3 ? 0 : line.size() - 3;
+  line.append(begin, end);
+  size_t found = line.find("\r\n\r\n", search);
+  if (found == std::string::npos) {
+    begin = end;
+    if (line.size() > HEADERS_SIZE_MAX)
+      return ResultCode_t::BUFFER_OVERFLOW + "Multipart headers are too long";
+    return ResultCode_t::SUCCESS;
+  }
+  // Return the bytes after the blank line to the fragment
+  begin = end - (line.size() - (found + 4));
+  line.resize(found + 2);
+  Result result = addPart();
+  line.clear();
+  return result;
+}
+
+/**
+ * @brief Add a part from its headers
+ * A file field is written to a temporary file, other fields are kept in memory
+ * until they grow too large
+ *
+ * @return Result error code
+ */
+Result Body::addPart() {
+  parts.emplace_back();
+  BodyPart_t & part = parts.back();
+  // Skip the line ending of the delimiter
+  size_t begin = 2;
+  while (begin < line.size()) {
+    size_t      end    = line.find("\r\n", begin);
+    std::string header = line.substr(begin, end - begin);
+    begin              = end + 2;
+    const std::string DISPOSITION = "Content-Disposition:";
+    if (header.size() < DISPOSITION.size() ||
+        !std::equal(DISPOSITION.begin(), DISPOSITION.end(), header.begin(),
+            [](char a, char b) { return tolower(a) == tolower(b); }))
+      continue;
+    getParameter(header, "name", part.name);
+    if (getParameter(header, "filename", part.fileName)) {
+      part.file = tmpfile();
+      if (part.file == nullptr)
+        return ResultCode_t::OPEN_FAILED + "Temporary file for multipart";
+    }
+  }
+  inPart = true;
+  state  = State_t::DATA;
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Add data to the current part, data outside of a part is discarded
+ *
+ * @param begin of the data
+ * @param length of the data
+ * @return Result error code
+ */
+Result Body::emit(const uint8_t * begin, size_t length) {
+  if (!inPart || length == 0)
+    return ResultCode_t::SUCCESS;
+  return append(parts.back(), begin, length);
+}
+
+/**
+ * @brief Append data to a part, spilling it to a temporary file once it grows
+ * too large for memory
+ *
+ * @param part to append to
+ * @param begin of the data
+ * @param length of the data
+ * @return Result error code
+ */
+Result Body::append(BodyPart_t & part, const uint8_t * begin, size_t length) {
+  part.size += length;
+  if (part.file == nullptr) {
+    if (part.size <= limits().memoryMax) {
+      part.data.append(begin, begin + length);
+      return ResultCode_t::SUCCESS;
+    }
+    part.file = tmpfile();
+    if (part.file == nullptr)
+      return ResultCode_t::OPEN_FAILED + "Temporary file for body";
+    if (fwrite(part.data.data(), 1, part.data.size(), part.file) !=
+        part.data.size())
+      return ResultCode_t::WRITE_FAULT + "Spilling body";
+    std::string().swap(part.data);
+  }
+  if (fwrite(begin, 1, length, part.file) != length)
+    return ResultCode_t::WRITE_FAULT + "Spilling body";
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get a parameter of a header value, i.e. name of
+ * "form-data; name=\"field\""
+ *
+ * @param header value with parameters separated by ';'
+ * @param name of the parameter
+ * @param value to return, without quotes
+ * @return true if the parameter is present
+ * @return false otherwise
+ */
+bool Body::getParameter(
+    const std::string & header, const std::string & name, std::string & value) {
+  size_t begin = header.find(';');
+  while (begin != std::string::npos) {
+    begin = header.find_first_not_of(' ', begin + 1);
+    if (begin == std::string::npos)
+      return false;
+    if (header.compare(begin, name.size(), name) == 0 &&
+        header.compare(begin + name.size(), 1, "=") == 0) {
+      begin += name.size() + 1;
+      size_t end;
+      if (header.compare(begin, 1, "\"") == 0)
+        end = header.find('"', ++begin);
+      else
+        end = header.find(';', begin);
+      if (end == std::string::npos)
+        end = header.size();
+      value = header.substr(begin, end - begin);
+      return true;
+    }
+    begin = header.find(';', begin);
+  }
+  return false;
+}
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
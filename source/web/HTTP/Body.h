@@ -0,0 +1,114 @@
+#ifndef _WEB_BODY_H_
+#define _WEB_BODY_H_
+
+#include "RequestHeaders.h"
+
+#include <FruitBowl.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+// The whole body, or a part of a multipart/form-data body
+struct BodyPart_t {
+  std::string name;
+  std::string fileName;
+
+  // Bytes in memory, or in a temporary file once spilled
+  std::string data;
+  FILE *      file = nullptr;
+  size_t      size = 0;
+};
+
+class Body {
+public:
+  Body(const Body &) = delete;
+  Body & operator=(const Body &) = delete;
+
+  Body();
+  ~Body();
+
+  /**
+   * @brief Set the limits of request bodies
+   *
+   * @param sizeMax largest body accepted
+   * @param memoryMax largest body or part kept in memory, larger ones are
+   * spilled to a temporary file
+   */
+  static void setLimits(size_t sizeMax, size_t memoryMax) {
+    limits().sizeMax   = sizeMax;
+    limits().memoryMax = memoryMax;
+  }
+
+  /**
+   * @brief Get the largest body accepted
+   *
+   * @return size_t bytes
+   */
+  static size_t getSizeMax() {
+    return limits().sizeMax;
+  }
+
+  Result open(const RequestHeaders & headers);
+  Result write(const uint8_t * begin, size_t length);
+  Result close();
+
+  const BodyPart_t * getPart() const;
+  const BodyPart_t * getPart(const std::string & name) const;
+
+private:
+  struct Limits_t {
+    size_t sizeMax   = 16 << 20;
+    size_t memoryMax = 1 << 20;
+  };
+
+  /**
+   * @brief Get the limits of request bodies
+   *
+   * @return Limits_t&
+   */
+  static Limits_t & limits() {
+    static Limits_t bodyLimits;
+    return bodyLimits;
+  }
+
+  Result parseData(const uint8_t *& begin, const uint8_t * end);
+  Result parseDelimiter(const uint8_t *& begin, const uint8_t * end);
+  Result parseHeaders(const uint8_t *& begin, const uint8_t * end);
+  Result addPart();
+  Result emit(const uint8_t * begin, size_t length);
+
+  static Result append(BodyPart_t & part, const uint8_t * begin, size_t length);
+  static bool   getParameter(const std::string & header,
+      const std::string & name, std::string & value);
+
+  enum class State_t : uint8_t { RAW, DATA, DELIMITER, HEADERS, EPILOGUE };
+
+  State_t state = State_t::RAW;
+
+  // Longest block of headers of a part
+  static const size_t HEADERS_SIZE_MAX = 8192;
+
+  std::vector<BodyPart_t> parts;
+
+  // Line ending, dashes and boundary that end each part
+  std::string delimiter;
+  // Bytes at the end of a fragment that may begin the delimiter
+  std::string carry;
+  // Headers of a part or the bytes after a delimiter
+  std::string line;
+
+  bool multipart = false;
+  bool inPart    = false;
+};
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_BODY_H_ */
@@ -2,6 +2,9 @@
 
 #include "EhbananaLog.h"
 
+#include <ctype.h>
+#include <sys/stat.h>
+
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
@@ -11,19 +14,28 @@ namespace HTTP {
  * File structure is xml:
  * <filesMatch "regular expression" cache-control="setting"/>
  *
+ * The rules are compiled and swapped in whole, requests in progress keep the
+ * previous rules. The file is reloaded when it is modified
+ *
  * @param fileName to parse
  * @return Result error code
  */
 Result CacheControl::populateList(const std::string & fileName) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // A file failing to load is retried once it is modified again
+  path     = fileName;
+  modified = getModified(fileName);
+
   MemoryMapped file(fileName, 0, MemoryMapped::SequentialScan);
   if (!file.isValid())
     return ResultCode_t::OPEN_FAILED +
            ("Opening cache control from: " + fileName);
   info("Loading cache control from \"" + fileName + "\"");
 
-  size_t                fileSize = static_cast<size_t>(file.size());
-  const unsigned char * data     = file.getData();
-  Result                result;
+  size_t                   fileSize = static_cast<size_t>(file.size());
+  const unsigned char *    data     = file.getData();
+  Result                   result;
+  std::shared_ptr<Rules_t> next = std::make_shared<Rules_t>();
 
   while (fileSize > 0) {
     switch (*data) {
@@ -49,11 +61,19 @@ Result CacheControl::populateList(const std::string & fileName) {
         result = parseTag(data, fileSize, filesMatch);
         if (!result)
           return result + "Parsing tag from cache.xml";
-        cacheFilesMatches.push_back(filesMatch);
+        try {
+          compile(*next, filesMatch);
+        } catch (const std::regex_error & e) {
+          return ResultCode_t::INVALID_DATA + e.what() +
+                 ("cache.xml: " + filesMatch.pattern);
+        }
       }
     }
   }
   file.close();
+
+  std::atomic_store(&rules, next);
+  ++generation;
   return ResultCode_t::SUCCESS;
 }
 
@@ -79,7 +99,7 @@ Result CacheControl::parseTag(const unsigned char *& data, size_t & fileSize,
   readCount = tag.add(data, fileSize, '"');
   data += readCount + 1;
   fileSize -= readCount + 1;
-  filesMatch.regex = std::regex(tag.getString());
+  filesMatch.pattern = tag.getString();
 
   tag       = Hash();
   readCount = tag.add(data, fileSize, '"');
@@ -104,21 +124,162 @@ Result CacheControl::parseTag(const unsigned char *& data, size_t & fileSize,
 }
 
 /**
- * @brief Get the cache control setting of the file extension
+ * @brief Compile a rule into the extension table, or a regex when it is not
+ * of the form ".*\.(ext|ext)$"
  *
- * @param extension to parse
- * @return const std::string& MIME type
+ * @param rules to add to
+ * @param filesMatch rule to compile
  */
-std::string CacheControl::getCacheControl(const std::string & fileName) {
-  for (CacheFilesMatch_t filesMatch : cacheFilesMatches) {
-    if (std::regex_match(fileName, filesMatch.regex)) {
-      return filesMatch.cacheControlHeader;
+void CacheControl::compile(
+    Rules_t & rules, const CacheFilesMatch_t & filesMatch) {
+  size_t index = rules.headers.size();
+  rules.headers.push_back(filesMatch.cacheControlHeader);
+
+  std::vector<std::string> extensions;
+  if (filesMatch.pattern == ".*") {
+    if (rules.matchAll > index)
+      rules.matchAll = index;
+  } else if (parseExtensions(filesMatch.pattern, extensions)) {
+    // An earlier rule of the same extension takes precedence
+    for (const std::string & extension : extensions)
+      rules.extensions.emplace(extension, index);
+  } else
+    rules.regexes.emplace_back(index, std::regex(filesMatch.pattern));
+}
+
+/**
+ * @brief Parse the extensions of a rule of the form ".*\.(ext|ext)$"
+ *
+ * @param pattern of the rule
+ * @param extensions to return
+ * @return true if the rule only matches its extensions
+ * @return false if the rule needs a regex
+ */
+bool CacheControl::parseExtensions(
+    const std::string & pattern, std::vector<std::string> & extensions) {
+  const std::string PREFIX = ".*\\.";
+  if (pattern.size() < PREFIX.size() + 2 ||
+      pattern.compare(0, PREFIX.size(), PREFIX) != 0 ||
+      pattern.back() != '$')
+    return false;
+  size_t begin = PREFIX.size();
+  size_t end   = pattern.size() - 1;
+  if (pattern[begin] == '(') {
+    if (pattern[end - 1] != ')')
+      return false;
+    ++begin;
+    --end;
+  }
+
+  std::string extension;
+  for (size_t i = begin; i <= end; ++i) {
+    if (i == end || pattern[i] == '|') {
+      if (extension.empty())
+        return false;
+      extensions.push_back(extension);
+      extension.clear();
+    } else if (isalnum(static_cast<unsigned char>(pattern[i])) ||
+               pattern[i] == '_' || pattern[i] == '-')
+      extension += pattern[i];
+    else
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Find the first rule matching a file name
+ * Regexes are only run for rules before the extension's, their answers are
+ * memoized
+ *
+ * @param rules to match
+ * @param fileName to match
+ * @return size_t index of the rule, -1 if none matches
+ */
+size_t CacheControl::match(Rules_t & rules, const std::string & fileName) {
+  size_t candidate = rules.matchAll;
+  size_t dot       = fileName.rfind('.');
+  if (dot != std::string::npos) {
+    auto i = rules.extensions.find(fileName.substr(dot + 1));
+    if (i != rules.extensions.end() && i->second < candidate)
+      candidate = i->second;
+  }
+  if (rules.regexes.empty() || rules.regexes.front().first > candidate)
+    return candidate;
+
+  std::lock_guard<std::mutex> lock(rules.mutex);
+  auto                        i = rules.memo.find(fileName);
+  if (i != rules.memo.end())
+    return i->second;
+  for (const std::pair<size_t, std::regex> & regex : rules.regexes) {
+    if (regex.first > candidate)
+      break;
+    if (std::regex_match(fileName, regex.second)) {
+      candidate = regex.first;
+      break;
     }
   }
+  if (rules.memo.size() >= MEMO_SIZE_MAX)
+    rules.memo.clear();
+  rules.memo[fileName] = candidate;
+  return candidate;
+}
+
+/**
+ * @brief Get the cache control setting of the file extension
+ *
+ * @param fileName to match
+ * @return std::string cache control header value
+ */
+std::string CacheControl::getCacheControl(const std::string & fileName) {
+  std::shared_ptr<Rules_t> current = std::atomic_load(&rules);
+  size_t                   index   = match(*current, fileName);
+  if (index < current->headers.size())
+    return current->headers[index];
   warn("Could not find cache control for \"" + fileName + "\"");
   return DEFAULT;
 }
 
+/**
+ * @brief Get the generation of the rules, incremented each time they load
+ * Reloads the rules first if their file was modified, checked at most once a
+ * second
+ *
+ * @return uint32_t generation
+ */
+uint32_t CacheControl::getGeneration() {
+  time_t now  = time(nullptr);
+  time_t last = checked.load();
+  if (now != last && checked.compare_exchange_strong(last, now)) {
+    std::string fileName;
+    time_t      loaded;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      fileName = path;
+      loaded   = modified;
+    }
+    if (!fileName.empty() && getModified(fileName) != loaded) {
+      Result result = populateList(fileName);
+      if (!result)
+        warn((result + "Reloading cache control").getMessage());
+    }
+  }
+  return generation.load();
+}
+
+/**
+ * @brief Get the modification time of a file
+ *
+ * @param fileName of the file
+ * @return time_t modification time, 0 if the file does not exist
+ */
+time_t CacheControl::getModified(const std::string & fileName) {
+  struct stat status;
+  if (stat(fileName.c_str(), &status) != 0)
+    return 0;
+  return status.st_mtime;
+}
+
 } // namespace HTTP
 } // namespace Web
-} // namespace Ehbanana
\ No newline at end of file
+} // namespace Ehbanana
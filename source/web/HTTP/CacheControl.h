@@ -6,17 +6,23 @@
 #include <FruitBowl.h>
 #include <MemoryMapped.h>
 
-#include <list>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <stdint.h>
 #include <string>
+#include <time.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
 
 struct CacheFilesMatch_t {
-  std::regex  regex;
+  std::string pattern;
   std::string cacheControlHeader;
 };
 
@@ -26,36 +32,62 @@ public:
   CacheControl & operator=(const CacheControl &) = delete;
 
   /**
-   * @brief Get the singleton instance
+   * @brief Construct a new Cache Control object
    *
-   * @return CacheControl*
    */
-  static CacheControl * Instance() {
-    static CacheControl instance;
-    return &instance;
-  }
+  CacheControl() {}
 
   Result populateList(const std::string & fileName);
 
   std::string getCacheControl(const std::string & fileName);
+  uint32_t    getGeneration();
 
 private:
-  /**
-   * @brief Construct a new Cache Control object
-   *
-   */
-  CacheControl() {}
+  // Rules compiled from cache.xml, replaced whole when it changes
+  struct Rules_t {
+    // Cache-Control of each rule, in file order
+    std::vector<std::string> headers;
+
+    // Rules of the form ".*\.(ext|ext)$", first rule of each extension
+    std::unordered_map<std::string, size_t> extensions;
+
+    // Other rules, in file order
+    std::vector<std::pair<size_t, std::regex>> regexes;
+
+    // First rule matching every file
+    size_t matchAll = static_cast<size_t>(-1);
+
+    // Rule of each file name that needed a regex
+    std::mutex                              mutex;
+    std::unordered_map<std::string, size_t> memo;
+  };
 
   Result parseTag(const unsigned char *& data, size_t & fileSize,
       CacheFilesMatch_t & filesMatch);
 
+  static void   compile(Rules_t & rules, const CacheFilesMatch_t & filesMatch);
+  static bool   parseExtensions(
+      const std::string & pattern, std::vector<std::string> & extensions);
+  static size_t match(Rules_t & rules, const std::string & fileName);
+  static time_t getModified(const std::string & fileName);
+
   const std::string DEFAULT = "no-store";
 
-  std::list<CacheFilesMatch_t> cacheFilesMatches;
+  // Memo entries kept before it is cleared
+  static const size_t MEMO_SIZE_MAX = 4096;
+
+  // Workers read the rules without locking, reloads swap them in
+  std::shared_ptr<Rules_t> rules = std::make_shared<Rules_t>();
+
+  std::mutex            mutex;
+  std::string           path;
+  time_t                modified = 0;
+  std::atomic<time_t>   checked{0};
+  std::atomic<uint32_t> generation{0};
 };
 
 } // namespace HTTP
 } // namespace Web
 } // namespace Ehbanana
 
-#endif /* _WEB_CACHE_CONTROL_H_ */
\ No newline at end of file
+#endif /* _WEB_CACHE_CONTROL_H_ */
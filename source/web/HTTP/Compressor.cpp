@@ -0,0 +1,131 @@
+#include "Compressor.h"
+
+#include "EhbananaLog.h"
+
+#ifdef EHBANANA_ZLIB
+#include <zlib.h>
+#endif
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+/**
+ * @brief Configure runtime compression
+ *
+ * @param enabled false never compresses
+ * @param minimumSize in bytes, smaller responses are sent as is
+ */
+void Compressor::configure(bool enabled, size_t minimumSize) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->enabled     = enabled;
+  this->minimumSize = minimumSize;
+}
+
+/**
+ * @brief Check if content of a size should be compressed
+ *
+ * @param size of the content
+ * @return true if compression is available, enabled, and size is large enough
+ * @return false otherwise
+ */
+bool Compressor::isCompressible(size_t size) {
+#ifdef EHBANANA_ZLIB
+  std::lock_guard<std::mutex> lock(mutex);
+  return enabled && size >= minimumSize;
+#else
+  (void)size;
+  return false;
+#endif
+}
+
+/**
+ * @brief Compress data with the gzip content coding
+ *
+ * @param data to compress
+ * @param size of data
+ * @param out compressed data
+ * @return Result error code, NOT_SUPPORTED when built without zlib
+ */
+Result Compressor::gzip(const uint8_t * data, size_t size, std::string & out) {
+#ifdef EHBANANA_ZLIB
+  z_stream stream = {};
+  // 15 bit window plus 16 writes the gzip wrapper
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+          Z_DEFAULT_STRATEGY) != Z_OK)
+    return ResultCode_t::EXCEPTION_OCCURRED + "Initializing deflate";
+
+  out.resize(deflateBound(&stream, static_cast<uLong>(size)));
+  stream.next_in   = const_cast<Bytef *>(data);
+  stream.avail_in  = static_cast<uInt>(size);
+  stream.next_out  = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  int status       = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END)
+    return ResultCode_t::EXCEPTION_OCCURRED +
+           ("Deflate status #" + std::to_string(status));
+  return ResultCode_t::SUCCESS;
+#else
+  (void)data;
+  (void)size;
+  (void)out;
+  return ResultCode_t::NOT_SUPPORTED + "Built without zlib";
+#endif
+}
+
+/**
+ * @brief Run a job on the background thread, starting it if needed
+ *
+ * @param job to run
+ */
+void Compressor::post(std::function<void()> job) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (stopping)
+    return;
+  jobs.push_back(std::move(job));
+  if (!thread.joinable())
+    thread = std::thread(&Compressor::run, this);
+  condition.notify_one();
+}
+
+/**
+ * @brief Stop the background thread, dropping jobs not yet started
+ * Posting a job after stopping starts the thread again
+ *
+ */
+void Compressor::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    jobs.clear();
+    condition.notify_one();
+  }
+  if (thread.joinable())
+    thread.join();
+  std::lock_guard<std::mutex> lock(mutex);
+  stopping = false;
+}
+
+/**
+ * @brief Background thread loop, runs jobs until stopped
+ *
+ */
+void Compressor::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+    if (stopping)
+      return;
+    std::function<void()> job = std::move(jobs.front());
+    jobs.pop_front();
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
\ No newline at end of file
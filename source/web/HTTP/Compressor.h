@@ -0,0 +1,56 @@
+#ifndef _WEB_COMPRESSOR_H_
+#define _WEB_COMPRESSOR_H_
+
+#include <FruitBowl.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+// Gzips the responses of one server, its jobs run on a thread of its own
+class Compressor {
+public:
+  Compressor(const Compressor &) = delete;
+  Compressor & operator=(const Compressor &) = delete;
+
+  /**
+   * @brief Construct a new Compressor object
+   *
+   */
+  Compressor() {}
+
+  void configure(bool enabled, size_t minimumSize);
+  bool isCompressible(size_t size);
+
+  Result gzip(const uint8_t * data, size_t size, std::string & out);
+
+  void post(std::function<void()> job);
+  void stop();
+
+private:
+  void run();
+
+  bool   enabled     = true;
+  size_t minimumSize = 1024;
+
+  // Jobs run on a background thread, away from the workers
+  std::mutex                        mutex;
+  std::condition_variable           condition;
+  std::deque<std::function<void()>> jobs;
+  std::thread                       thread;
+  bool                              stopping = false;
+};
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_COMPRESSOR_H_ */
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "Date.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+namespace {
+
+const char * const DAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char * const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+const int64_t SECONDS_PER_DAY = 86400;
+
+/**
+ * @brief Count the days from 1970-01-01 to a date in the Gregorian calendar
+ * Independent of the local time zone, unlike mktime
+ *
+ * @param year full year
+ * @param month 1 to 12
+ * @param day 1 to 31
+ * @return int64_t days, negative before 1970
+ */
+int64_t daysFromCivil(int64_t year, int64_t month, int64_t day) {
+  year -= month <= 2;
+  int64_t era       = (year >= 0 ? year : year - 399) / 400;
+  int64_t yearOfEra = year - era * 400;
+  int64_t dayOfYear =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int64_t dayOfEra =
+      yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * @brief Convert days from 1970-01-01 to a date in the Gregorian calendar
+ *
+ * @param days from 1970-01-01
+ * @param year to return
+ * @param month to return, 1 to 12
+ * @param day to return, 1 to 31
+ */
+void civilFromDays(
+    int64_t days, int64_t & year, int64_t & month, int64_t & day) {
+  days += 719468;
+  int64_t era       = (days >= 0 ? days : days - 146096) / 146097;
+  int64_t dayOfEra  = days - era * 146097;
+  int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 -
+                          dayOfEra / 146096) /
+                      365;
+  int64_t dayOfYear =
+      dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int64_t monthShifted = (5 * dayOfYear + 2) / 153;
+  day   = dayOfYear - (153 * monthShifted + 2) / 5 + 1;
+  month = monthShifted < 10 ? monthShifted + 3 : monthShifted - 9;
+  year  = yearOfEra + era * 400 + (month <= 2);
+}
+
+} // namespace
+
+/**
+ * @brief Format a time as an HTTP date, i.e. "Sun, 06 Nov 1994 08:49:37 GMT"
+ *
+ * @param time seconds since the epoch
+ * @return std::string date
+ */
+std::string formatDate(time_t time) {
+  int64_t seconds = static_cast<int64_t>(time);
+  int64_t days    = seconds / SECONDS_PER_DAY;
+  seconds %= SECONDS_PER_DAY;
+  if (seconds < 0) {
+    seconds += SECONDS_PER_DAY;
+    --days;
+  }
+  int64_t year, month, day;
+  civilFromDays(days, year, month, day);
+  // 1970-01-01 was a Thursday
+  int64_t weekday = (days % 7 + 11) % 7;
+
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+      DAYS[weekday], static_cast<int>(day), MONTHS[month - 1],
+      static_cast<int>(year), static_cast<int>(seconds / 3600),
+      static_cast<int>(seconds / 60 % 60), static_cast<int>(seconds % 60));
+  return buffer;
+}
+
+/**
+ * @brief Parse an HTTP date, i.e. "Sun, 06 Nov 1994 08:49:37 GMT"
+ * Only the preferred format is understood
+ *
+ * @param date to parse
+ * @return time_t seconds since the epoch, 0 if invalid
+ */
+time_t parseDate(const std::string & date) {
+  char weekday[4]   = {};
+  char monthName[4] = {};
+  int  day, year, hour, minute, second;
+  if (sscanf(date.c_str(), "%3s, %d %3s %d %d:%d:%d GMT", weekday, &day,
+          monthName, &year, &hour, &minute, &second) != 7)
+    return 0;
+  for (int month = 0; month < 12; ++month) {
+    if (strcmp(monthName, MONTHS[month]) == 0)
+      return static_cast<time_t>(
+          daysFromCivil(year, month + 1, day) * SECONDS_PER_DAY +
+          hour * 3600 + minute * 60 + second);
+  }
+  return 0;
+}
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef _WEB_DATE_H_
+#define _WEB_DATE_H_
+
+#include <string>
+#include <time.h>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+std::string formatDate(time_t time);
+time_t      parseDate(const std::string & date);
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_DATE_H_ */
\ No newline at end of file
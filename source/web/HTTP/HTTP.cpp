@@ -1,12 +1,14 @@
 #include "HTTP.h"
 
-#include "CacheControl.h"
 #include "EhbananaLog.h"
-#include "MIMETypes.h"
+
+#include "../Server.h"
 
 #include <algorithm/sha1.hpp>
 #include <base64.h>
 
+#include <algorithm>
+
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
@@ -14,8 +16,14 @@ namespace HTTP {
 /**
  * @brief Construct a new HTTP::HTTP object
  *
+ * @param gui that owns this server
  */
-HTTP::HTTP() {}
+HTTP::HTTP(EBGUI_t gui) :
+  router(&gui->server->getRouter()),
+  resourceIndex(&gui->server->getResourceIndex()),
+  assetCache(&gui->server->getAssetCache()),
+  compressor(&gui->server->getCompressor()), request(router),
+  TIMEOUT_KEEP_ALIVE(std::max<uint8_t>(gui->settings.timeoutKeepAlive, 1)) {}
 
 /**
  * @brief Destroy the HTTP::HTTP object
@@ -25,43 +33,122 @@ HTTP::~HTTP() {}
 
 /**
  * @brief Process a received buffer, could be the entire message or a fragment
+ * May hold several pipelined requests, each is answered in order
  *
  * @param begin character
  * @param length of buffer
  * @return Result error code
  */
 Result HTTP::processReceiveBuffer(const uint8_t * begin, size_t length) {
+  if (stopped) {
+    // Bytes behind an upgrade request belong to the next protocol
+    if (changeRequest != AppProtocol_t::NONE)
+      leftover.append(begin, begin + length);
+    return ResultCode_t::INCOMPLETE;
+  }
+  if (!pending.empty()) {
+    // Keep the requests in order behind those already waiting
+    pending.append(begin, begin + length);
+    if (pending.size() > PENDING_SIZE_MAX)
+      return ResultCode_t::BUFFER_OVERFLOW + "HTTP pipelined requests";
+    return ResultCode_t::INCOMPLETE;
+  }
+  return parseRequests(begin, begin + length);
+}
+
+/**
+ * @brief Parse requests from a buffer and queue their replies
+ * Bytes are held in pending once the pipeline is full. A malformed request is
+ * answered with an error status and ends the connection
+ *
+ * @param begin character pointer
+ * @param end character pointer
+ * @return Result error code
+ */
+Result HTTP::parseRequests(const uint8_t * begin, const uint8_t * end) {
   Result result;
-  switch (state) {
-    case State_t::READING:
-      result = request.parse(begin, begin + length);
-      if (!result)
-        return result;
-      state = State_t::READING_DONE;
-      // Fall through
-    case State_t::READING_DONE:
-      // Handle request
-      result = handleRequest();
-      if (!result) {
-        warn((result + "Handling HTTP request").getMessage());
-        reply = Reply::stockReply(result);
-      }
-      addTransmitBuffer(reply.getBuffers());
-      state = State_t::WRITING;
+  while (begin != end && !stopped) {
+    if (transmissions.size() >= PIPELINE_DEPTH_MAX || isStreaming()) {
+      pending.append(begin, end);
       return ResultCode_t::INCOMPLETE;
-    case State_t::WRITING:
-    case State_t::WRITING_DONE:
-    case State_t::COMPLETE:
-    default:
-      return ResultCode_t::INVALID_STATE +
-             ("HTTP: " + std::to_string(static_cast<uint8_t>(state)));
+    }
+    result = request.parse(begin, end);
+    if (result == ResultCode_t::INCOMPLETE)
+      break;
+    if (!result) {
+      reject(result + "Parsing HTTP request");
+      return ResultCode_t::INCOMPLETE;
+    }
+    respond();
   }
+  if (changeRequest != AppProtocol_t::NONE)
+    leftover.append(begin, end);
+  return ResultCode_t::INCOMPLETE;
+}
+
+/**
+ * @brief Handle the parsed request and queue its reply for transmission
+ * Starts parsing the next request
+ *
+ */
+void HTTP::respond() {
+  transmissions.emplace_back();
+  Transmission_t & transmission = transmissions.back();
+  Reply &          reply        = transmission.reply;
+
+  Result result = handleRequest(reply);
+  if (!result) {
+    warn((result + "Handling HTTP request").getMessage());
+    reply = Reply::stockReply(result);
+  }
+
+  if (result && !request.isBodyRejected() &&
+      request.getHeaders().getConnection() ==
+          RequestHeaders::Connection_t::UPGRADE) {
+    changeRequest = AppProtocol_t::WEBSOCKET;
+    stopped       = true;
+  } else {
+    // The unread body would be parsed as the next request, an unframed stream
+    // is ended by closing
+    bool keepAlive = request.isKeepAlive() && !request.isBodyRejected() &&
+                     !reply.isEndedByClose();
+    reply.setKeepAlive(keepAlive, TIMEOUT_KEEP_ALIVE);
+    stopped = !keepAlive;
+  }
+  reply.compress(request.getHeaders(), *compressor);
+
+  for (const asio::const_buffer & buffer : reply.getBuffers())
+    transmission.remaining += buffer.size();
+  addTransmitBuffer(reply.getBuffers());
+  request = Request(router);
+}
+
+/**
+ * @brief Queue the error reply to a malformed request and stop
+ * The rest of the stream cannot be framed, the connection is closed once the
+ * replies ahead and this one are sent
+ *
+ * @param result of parsing the request
+ */
+void HTTP::reject(const Result & result) {
+  warn(result.getMessage());
+  transmissions.emplace_back();
+  Transmission_t & transmission = transmissions.back();
+  Reply &          reply        = transmission.reply;
+  reply = Reply::stockReply(result);
+  reply.setKeepAlive(false, TIMEOUT_KEEP_ALIVE);
+  stopped = true;
+
+  for (const asio::const_buffer & buffer : reply.getBuffers())
+    transmission.remaining += buffer.size();
+  addTransmitBuffer(reply.getBuffers());
 }
 
 /**
  * @brief Update the transmit buffers with number of bytes transmitted
  * Removes buffers that have been completely transmitted. Moves the start
- * pointer of the next buffer that has not been transmitted.
+ * pointer of the next buffer that has not been transmitted. Releases the
+ * replies that have been transmitted and parses the requests waiting on them
  *
  * @param bytesWritten
  * @return true when all transmit buffers have been transmitted
@@ -69,18 +156,82 @@ Result HTTP::processReceiveBuffer(const uint8_t * begin, size_t length) {
  */
 bool HTTP::updateTransmitBuffers(size_t bytesWritten) {
   bool done = AppProtocol::updateTransmitBuffers(bytesWritten);
-  if (done) {
-    if (request.getHeaders().getConnection() ==
-        RequestHeaders::Connection_t::KEEP_ALIVE) {
-      request = Request();
-      reply   = Reply();
-      state   = State_t::READING;
-    } else
-      state = State_t::COMPLETE;
+  while (bytesWritten > 0 && !transmissions.empty()) {
+    Transmission_t & transmission = transmissions.front();
+    size_t length = std::min(bytesWritten, transmission.remaining);
+    transmission.remaining -= length;
+    bytesWritten -= length;
+    if (transmission.remaining != 0)
+      continue;
+    if (!transmission.reply.isStreaming()) {
+      transmissions.pop_front();
+      continue;
+    }
+    // Nothing is queued behind a stream, produce its next chunk
+    Result result = transmission.reply.produce();
+    if (!result) {
+      // The head is sent, close the connection to abort the reply
+      warn((result + "Producing HTTP stream").getMessage());
+      stopped = true;
+      transmissions.pop_front();
+    } else {
+      for (const asio::const_buffer & buffer : transmission.reply.getBuffers())
+        transmission.remaining += buffer.size();
+      if (transmission.remaining != 0)
+        addTransmitBuffer(transmission.reply.getBuffers());
+      else {
+        // An unframed stream finished without a last chunk
+        transmissions.pop_front();
+      }
+    }
+    done = !hasTransmitBuffers();
+  }
+
+  if (!pending.empty() && transmissions.size() < PIPELINE_DEPTH_MAX &&
+      !isStreaming()) {
+    std::string     bytes;
+    bytes.swap(pending);
+    const uint8_t * begin = reinterpret_cast<const uint8_t *>(bytes.data());
+    Result          result = parseRequests(begin, begin + bytes.size());
+    if (!result && result != ResultCode_t::INCOMPLETE) {
+      warn(result.getMessage());
+      stopped = true;
+    }
+    done = !hasTransmitBuffers();
   }
   return done;
 }
 
+/**
+ * @brief Get the file a transmit buffer can be sent from without copying
+ * Only the body of a reply to a large static file is backed by its file
+ *
+ * @param buffer in the transmit queue
+ * @param fd descriptor to return
+ * @param offset of the buffer in the file to return
+ * @return true if the buffer is backed by a file
+ * @return false if the buffer must be written from memory
+ */
+bool HTTP::getTransmitFile(
+    const asio::const_buffer & buffer, int & fd, uint64_t & offset) {
+  for (const Transmission_t & transmission : transmissions) {
+    if (transmission.reply.getFile(buffer, fd, offset))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Check if the last queued reply is a stream still producing
+ * Pipelined requests wait behind it
+ *
+ * @return true if a stream is producing
+ * @return false otherwise
+ */
+bool HTTP::isStreaming() {
+  return !transmissions.empty() && transmissions.back().reply.isStreaming();
+}
+
 /**
  * @brief Check the completion of the protocol
  *
@@ -88,7 +239,7 @@ bool HTTP::updateTransmitBuffers(size_t bytesWritten) {
  * @return false if all messages have been processed and no more are expected
  */
 bool HTTP::isDone() {
-  return state == State_t::COMPLETE;
+  return stopped && transmissions.empty();
 }
 
 /**
@@ -97,40 +248,70 @@ bool HTTP::isDone() {
  * @return AppProtocol_t protocol requested, NONE for no change requested
  */
 AppProtocol_t HTTP::getChangeRequest() {
-  if (request.getHeaders().getConnection() ==
-      RequestHeaders::Connection_t::UPGRADE) {
-    if (request.getHeaders().getUpgrade() ==
-        RequestHeaders::Upgrade_t::WEB_SOCKET)
-      return AppProtocol_t::WEBSOCKET;
-  }
-  return AppProtocol_t::NONE;
+  return changeRequest;
+}
+
+/**
+ * @brief Get the time the connection may be idle before it is closed
+ * Longer than the WebSocket alive check, a persistent connection waits for the
+ * next page load
+ *
+ * @return std::chrono::seconds timeout
+ */
+std::chrono::seconds HTTP::getTimeout() {
+  return TIMEOUT_KEEP_ALIVE;
 }
 
 /**
  * @brief Handle the request and populate the reply
  *
+ * @param reply to populate
  * @return Result error code
  */
-Result HTTP::handleRequest() {
+Result HTTP::handleRequest(Reply & reply) {
   Result result;
+  bool   upgrade = request.getHeaders().getConnection() ==
+                 RequestHeaders::Connection_t::UPGRADE;
+  if (request.isBodyTooLarge()) {
+    reply = Reply::stockReply(Status_t::PAYLOAD_TOO_LARGE);
+    return ResultCode_t::SUCCESS;
+  }
+  if (request.isBodyNotSupported()) {
+    reply = Reply::stockReply(Status_t::NOT_IMPLEMENTED);
+    return ResultCode_t::SUCCESS;
+  }
+  // Routed once its headers were parsed, to receive the body
+  std::shared_ptr<EBStream> stream = request.getStream();
+  if (stream != nullptr) {
+    result = handleRoute(reply, stream);
+    if (!result)
+      return result + "Handling route";
+    return ResultCode_t::SUCCESS;
+  }
+
   switch (request.getMethod().get()) {
     case Hash::calculateHash("GET"):
-      if (request.getHeaders().getConnection() ==
-          RequestHeaders::Connection_t::UPGRADE) {
-        result = handleUpgrade();
+      if (upgrade) {
+        result = handleUpgrade(reply);
         if (!result)
           return result + "Handling Connection: Upgrade";
       } else {
-        result = handleGET();
+        result = handleGET(reply);
         if (!result)
           return result + "Handling GET";
       }
       break;
     case Hash::calculateHash("POST"):
-      result = handlePOST();
+      result = handlePOST(reply);
       if (!result)
         return result + "Handling POST";
       break;
+    case Hash::calculateHash("PUT"):
+    case Hash::calculateHash("DELETE"):
+      // Only served by routes
+      return ResultCode_t::NOT_SUPPORTED +
+             ("No route for: " + request.getMethod().getString() + " " +
+                 request.getURI().getString());
     default:
       return ResultCode_t::UNKNOWN_HASH +
              ("Request method: " + request.getMethod().getString());
@@ -141,9 +322,10 @@ Result HTTP::handleRequest() {
 /**
  * @brief Handle the GET request and populate the reply
  *
+ * @param reply to populate
  * @return Result error code
  */
-Result HTTP::handleGET() {
+Result HTTP::handleGET(Reply & reply) {
   std::string uri = request.getURI().getString();
   if (request.getQueries().empty())
     info("GET URI: \"" + uri + "\"");
@@ -164,38 +346,46 @@ Result HTTP::handleGET() {
   if (uri[uri.size() - 1] == '/')
     uri += "index.html";
 
-  // Determine the file extension.
-  reply.addHeader("Content-Type", MIMETypes::Instance()->getType(uri));
-  MemoryMapped * file =
-      new MemoryMapped(root() + uri, 0, MemoryMapped::SequentialScan);
-  if (!file->isValid()) {
-    file->close();
-    delete file;
-    return ResultCode_t::OPEN_FAILED + (root() + uri);
-  }
-  reply.addHeader("Content-Length", std::to_string(file->size()));
-  reply.addHeader(
-      "Cache-Control", CacheControl::Instance()->getCacheControl(uri));
-  switch (request.getHeaders().getConnection()) {
-    default:
-    case RequestHeaders::Connection_t::CLOSE:
-      reply.addHeader("Connection", "close");
-      break;
-    case RequestHeaders::Connection_t::KEEP_ALIVE:
-      reply.addHeader("Connection", "keep-alive");
-      break;
+  // Files missing from the index are not found without touching the disk
+  ResourcePtr_t resource = resourceIndex->find(uri);
+  if (resource == nullptr)
+    return ResultCode_t::OPEN_FAILED + ("No such file: " + uri);
+
+  AssetPtr_t asset;
+  Result     result = assetCache->get(resource, request.getHeaders(), asset);
+  if (!result)
+    return result;
+  const RequestHeaders & headers = request.getHeaders();
+  if (headers.isNotModified(asset->etag, asset->modified)) {
+    reply.setNotModified(asset);
+    return ResultCode_t::SUCCESS;
   }
-  reply.setContent(file);
+  reply.setContent(asset);
+  if (!headers.hasRange() ||
+      !headers.isRangeCurrent(asset->etag, asset->modified))
+    return ResultCode_t::SUCCESS;
 
+  std::vector<ByteRange_t> ranges;
+  result = headers.getRanges(asset->size, ranges);
+  if (result)
+    reply.setRanges(ranges);
+  else if (result == ResultCode_t::INVALID_DATA) {
+    reply = Reply();
+    reply.setStatus(Status_t::RANGE_NOT_SATISFIABLE);
+    reply.addHeader("Content-Range", "bytes */" + std::to_string(asset->size));
+    reply.addHeader("Content-Length", "0");
+  }
+  // Else the range is ignored and the whole asset is sent
   return ResultCode_t::SUCCESS;
 }
 
 /**
  * @brief Handle the POST request and populate the reply
  *
+ * @param reply to populate
  * @return Result error code
  */
-Result HTTP::handlePOST() {
+Result HTTP::handlePOST(Reply & reply) {
   if (request.getQueries().empty())
     info("POST URI: \"" + request.getURI().getString() + "\"");
   else {
@@ -213,14 +403,42 @@ Result HTTP::handlePOST() {
   return ResultCode_t::NOT_SUPPORTED + "handlePOST";
 }
 
+/**
+ * @brief Handle a routed request with its process and populate the reply
+ * A response produced in one call is sent whole with its length, else it is
+ * streamed one chunk at a time
+ *
+ * @param reply to populate
+ * @param stream routed for the request, its body received
+ * @return Result error code
+ */
+Result HTTP::handleRoute(Reply & reply, std::shared_ptr<EBStream> stream) {
+  info(request.getMethod().getString() + " route URI: \"" +
+       request.getURI().getString() + "\"");
+
+  Result result = stream->produce();
+  if (!result)
+    return result;
+  for (const std::pair<std::string, std::string> & header :
+      stream->getHeaders())
+    reply.addHeader(header.first, header.second);
+  if (stream->isChunked())
+    reply.setStream(stream);
+  else {
+    const std::string & body = stream->getChunk();
+    reply.appendContent(body);
+    reply.addHeader("Content-Length", std::to_string(body.size()));
+  }
+  return ResultCode_t::SUCCESS;
+}
+
 /**
  * @brief Handle a request to upgrade the connection
  *
- * @param request to handle
  * @param reply to populate
  * @return Result error code
  */
-Result HTTP::handleUpgrade() {
+Result HTTP::handleUpgrade(Reply & reply) {
   if (request.getHeaders().getUpgrade() !=
       RequestHeaders::Upgrade_t::WEB_SOCKET)
     return ResultCode_t::NOT_SUPPORTED +
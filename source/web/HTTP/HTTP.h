@@ -1,11 +1,17 @@
 #ifndef _WEB_HTTP_HTTP_H_
 #define _WEB_HTTP_HTTP_H_
 
+#include "AssetCache.h"
+#include "Compressor.h"
 #include "Reply.h"
 #include "Request.h"
+#include "ResourceIndex.h"
 
-#include "..\AppProtocol.h"
+#include "../AppProtocol.h"
 
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <string>
 
 namespace Ehbanana {
@@ -17,51 +23,57 @@ public:
   HTTP(const HTTP &) = delete;
   HTTP & operator=(const HTTP &) = delete;
 
-  HTTP();
+  HTTP(EBGUI_t gui);
   ~HTTP();
 
   Result        processReceiveBuffer(const uint8_t * begin, size_t length);
   bool          updateTransmitBuffers(size_t bytesWritten);
+  bool          getTransmitFile(
+      const asio::const_buffer & buffer, int & fd, uint64_t & offset);
   bool          isDone();
   AppProtocol_t getChangeRequest();
 
-  /**
-   * @brief Set the root directory to serve http from
-   *
-   * @param httpRoot relative or absolute path
-   */
-  static void setRoot(const std::string & httpRoot) {
-    root() = httpRoot;
-  }
+  std::chrono::seconds getTimeout();
 
 private:
-  /**
-   * @brief Get the root of the http directory
-   *
-   * @return std::string&
-   */
-  static std::string & root() {
-    static std::string httpRoot;
-    return httpRoot;
-  }
-
-  Result handleRequest();
-  Result handleGET();
-  Result handlePOST();
-  Result handleUpgrade();
-
-  enum class State_t : uint8_t {
-    READING,
-    READING_DONE,
-    WRITING,
-    WRITING_DONE,
-    COMPLETE
+  Result parseRequests(const uint8_t * begin, const uint8_t * end);
+  void   respond();
+  void   reject(const Result & result);
+  bool   isStreaming();
+
+  Result handleRequest(Reply & reply);
+  Result handleGET(Reply & reply);
+  Result handlePOST(Reply & reply);
+  Result handleRoute(Reply & reply, std::shared_ptr<EBStream> stream);
+  Result handleUpgrade(Reply & reply);
+
+  struct Transmission_t {
+    Reply  reply;
+    size_t remaining = 0;
   };
 
-  State_t state = State_t::READING;
+  // Replies queued ahead of the client reading them, further pipelined
+  // requests wait in pending
+  static const size_t PIPELINE_DEPTH_MAX = 16;
+  static const size_t PENDING_SIZE_MAX   = 1024 * 1024;
+
+  // Of the server that accepted the connection
+  const Router *  router;
+  ResourceIndex * resourceIndex;
+  AssetCache *    assetCache;
+  Compressor *    compressor;
 
   Request request;
-  Reply   reply;
+
+  std::deque<Transmission_t> transmissions;
+  std::string                pending;
+
+  // A persistent connection idle for longer is closed
+  const std::chrono::seconds TIMEOUT_KEEP_ALIVE;
+
+  // No more requests are accepted once a reply closes or upgrades
+  bool          stopped       = false;
+  AppProtocol_t changeRequest = AppProtocol_t::NONE;
 };
 
 } // namespace HTTP
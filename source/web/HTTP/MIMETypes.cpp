@@ -7,10 +7,12 @@ namespace Web {
 namespace HTTP {
 
 /**
- * @brief Populates the list of types from a file
+ * @brief Populates the table of types from a file
  * File structure:
  * Each line contains one type: .htm text/html
  *
+ * The first type of an extension is kept, extensions match in any case
+ *
  * @param fileName to parse
  * @return Result error code
  */
@@ -20,99 +22,111 @@ Result MIMETypes::populateList(const std::string & fileName) {
     return ResultCode_t::OPEN_FAILED + ("Opening MIME types from: " + fileName);
   info("Loading MIME types from \"" + fileName + "\"");
 
-  size_t                fileSize = static_cast<size_t>(file.size());
-  const unsigned char * data     = file.getData();
-  size_t                readCount;
-
-  while (fileSize > 0) {
-    if (*data == '\r') {
-      ++data;
-      --fileSize;
-    }
-    if (*data == '\n') {
-      ++data;
-      --fileSize;
-    }
-    Hash extension;
-    readCount = extension.add(data, fileSize, ' ');
-    data += readCount + 1;
-    fileSize -= readCount + 1;
-    Hash mimeType;
-    readCount = mimeType.add(data, fileSize, '\r');
-    data += readCount;
-    fileSize -= readCount;
-    typeBuckets[(extension.get() & 0xF)].push_back(
-        {extension.get(), mimeType.getString(), 0});
+  std::string_view data(reinterpret_cast<const char *>(file.getData()),
+      static_cast<size_t>(file.size()));
+  types.clear();
+  while (!data.empty()) {
+    size_t           newline = data.find('\n');
+    std::string_view line    = data.substr(0, newline);
+    data.remove_prefix(newline == std::string_view::npos ? data.size()
+                                                         : newline + 1);
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    size_t space = line.find(' ');
+    if (space == std::string_view::npos || line[0] != '.')
+      continue;
+    MIMEType_t type;
+    for (char c : line.substr(1, space - 1))
+      type.extension += lower(c);
+    type.type = std::string(line.substr(space + 1));
+    types.push_back(type);
   }
   file.close();
-  sortList();
+
+  uint32_t capacity = 16;
+  while (capacity < types.size() * 2)
+    capacity <<= 1;
+  mask = capacity - 1;
+  slots.assign(capacity, {0, 0});
+  for (uint32_t i = 0; i < types.size(); ++i) {
+    uint32_t typeHash = hash(types[i].extension);
+    uint32_t slot     = typeHash & mask;
+    while (slots[slot].second != 0 &&
+           types[slots[slot].second - 1].extension != types[i].extension)
+      slot = (slot + 1) & mask;
+    if (slots[slot].second == 0)
+      slots[slot] = {typeHash, i + 1};
+  }
   return ResultCode_t::SUCCESS;
 }
 
 /**
  * @brief Get the MIME type of the file name
+ * Probes the table in place, nothing is copied
  *
  * @param fileName to parse
+ * @param quiet true does not warn of an unknown type
  * @return const std::string& MIME type
  */
-const std::string & MIMETypes::getType(const std::string & fileName) {
-  // Extract the file extentsion
-  std::string fileExtension;
-  bool        dotPresent = false;
-  for (char c : fileName) {
-    if (c == '/') {
-      fileExtension.erase();
-      dotPresent = false;
-    } else if (c == '.') {
-      fileExtension = ".";
-      dotPresent    = true;
-    } else if (dotPresent)
-      fileExtension += c;
+const std::string & MIMETypes::getType(
+    std::string_view fileName, bool quiet) const {
+  // The extension follows the last dot of the last path segment
+  size_t dot   = fileName.rfind('.');
+  size_t slash = fileName.rfind('/');
+  if (dot == std::string_view::npos ||
+      (slash != std::string_view::npos && slash > dot) || slots.empty()) {
+    if (!quiet)
+      warn("Could not find MIME type for \"" + std::string(fileName) + "\"");
+    return UNKNOWN_MIME_TYPE;
   }
+  std::string_view extension = fileName.substr(dot + 1);
 
-  // Every SORT_TIMER_RESET times this is called, sort the list to improve fetch
-  // performance
-  sortTimer--;
-  if (sortTimer == 0) {
-    sortTimer = SORT_TIMER_RESET;
-    sortList();
+  uint32_t extensionHash = hash(extension);
+  uint32_t slot          = extensionHash & mask;
+  while (slots[slot].second != 0) {
+    if (slots[slot].first == extensionHash &&
+        equals(extension, types[slots[slot].second - 1].extension))
+      return types[slots[slot].second - 1].type;
+    slot = (slot + 1) & mask;
   }
-
-  // Go to the bucket given by the last nibble of the hash, and search that for
-  // the extension
-  HashValue_t hash = Hash::calculateHash(fileExtension);
-  for (MIMEType_t & type : typeBuckets[(hash & 0xF)]) {
-    if (type.fileExtension == hash) {
-      ++type.usage;
-      return type.type;
-    }
-  }
-  warn("Could not find MIME type for \"" + fileExtension + "\"");
+  if (!quiet)
+    warn("Could not find MIME type for \"." + std::string(extension) + "\"");
   return UNKNOWN_MIME_TYPE;
 }
 
 /**
- * @brief Sort each bucket to place the most used types at the top
+ * @brief Hash an extension in any case, FNV-1a
  *
+ * @param extension to hash
+ * @return uint32_t hash
  */
-void MIMETypes::sortList() {
-  for (uint8_t i = 0; i < 16; ++i) {
-    std::list<MIMEType_t> & typeBucket = typeBuckets[i];
-    typeBucket.sort(std::greater<MIMEType_t>());
+uint32_t MIMETypes::hash(std::string_view extension) {
+  uint32_t value = 2166136261u;
+  for (char c : extension) {
+    value ^= static_cast<uint8_t>(lower(c));
+    value *= 16777619u;
   }
+  return value;
 }
 
 /**
- * @brief Greater than operator for MIMEType_t comparing their usage rate
+ * @brief Compare an extension in any case to a lowercase key
  *
- * @param left type
- * @param right type
- * @return left.usage > right.usage
+ * @param extension to compare
+ * @param key lowercase
+ * @return true if equal ignoring case
+ * @return false otherwise
  */
-bool operator>(const MIMEType_t & left, const MIMEType_t & right) {
-  return left.usage > right.usage;
+bool MIMETypes::equals(std::string_view extension, const std::string & key) {
+  if (extension.size() != key.size())
+    return false;
+  for (size_t i = 0; i < key.size(); ++i) {
+    if (lower(extension[i]) != key[i])
+      return false;
+  }
+  return true;
 }
 
 } // namespace HTTP
 } // namespace Web
-} // namespace Ehbanana
\ No newline at end of file
+} // namespace Ehbanana
@@ -4,60 +4,64 @@
 #include <FruitBowl.h>
 #include <MemoryMapped.h>
 
-#include <list>
 #include <stdint.h>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
 
 struct MIMEType_t {
-  const HashValue_t fileExtension;
-  const std::string type;
-  uint32_t          usage = 0;
+  std::string extension;
+  std::string type;
 };
 
-bool operator>(const MIMEType_t & left, const MIMEType_t & right);
-
 class MIMETypes {
 public:
   MIMETypes(const MIMETypes &) = delete;
   MIMETypes & operator=(const MIMETypes &) = delete;
 
   /**
-   * @brief Get the singleton instance
+   * @brief Construct a new MIMETypes object
    *
-   * @return MIMETypes*
    */
-  static MIMETypes * Instance() {
-    static MIMETypes instance;
-    return &instance;
-  }
+  MIMETypes() {}
 
   Result populateList(const std::string & fileName);
 
-  const std::string & getType(const std::string & extension);
+  const std::string & getType(
+      std::string_view fileName, bool quiet = false) const;
 
 private:
   /**
-   * @brief Construct a new MIMETypes object
+   * @brief Lowercase an ASCII character, without the locale
    *
+   * @param c character
+   * @return char lowercase character
    */
-  MIMETypes() {}
+  static char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+  }
 
-  void sortList();
+  static uint32_t hash(std::string_view extension);
+  static bool     equals(std::string_view extension, const std::string & key);
 
-  const uint32_t    SORT_TIMER_RESET  = 100;
   const std::string UNKNOWN_MIME_TYPE = "application/octet-stream";
 
-  uint32_t sortTimer = SORT_TIMER_RESET;
+  // Populated once before serving, lookups never write so workers do not lock
+  std::vector<MIMEType_t> types;
 
-  std::list<MIMEType_t> typeBuckets[16];
+  // Open addressing, the hash and index + 1 of each type, 0 for an empty slot.
+  // Kept at most half full
+  std::vector<std::pair<uint32_t, uint32_t>> slots;
+  uint32_t                                   mask = 0;
 };
 
 } // namespace HTTP
 } // namespace Web
 } // namespace Ehbanana
 
-#endif /* _WEB_MIME_TYPES_H_ */
\ No newline at end of file
+#endif /* _WEB_MIME_TYPES_H_ */
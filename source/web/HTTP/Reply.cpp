@@ -1,5 +1,8 @@
 #include "Reply.h"
 
+#include <algorithm>
+#include <ctype.h>
+
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
@@ -8,22 +11,13 @@ namespace HTTP {
  * @brief Construct a new Reply:: Reply object
  *
  */
-Reply::Reply() {
-  file = nullptr;
-}
+Reply::Reply() {}
 
 /**
  * @brief Destroy the Reply:: Reply object
- * Delete attached file if present
  *
  */
-Reply::~Reply() {
-  if (file != nullptr) {
-    file->close();
-    delete file;
-    file = nullptr;
-  }
-}
+Reply::~Reply() {}
 
 /**
  * @brief Copy constructor
@@ -42,13 +36,16 @@ Reply::Reply(const Reply & that) {
  */
 Reply & Reply::operator=(const Reply & that) {
   if (this != &that) {
-    if (this->file != nullptr)
-      this->file->close();
-    this->file    = that.file;
+    this->asset   = that.asset;
     this->content = that.content;
-    this->buffers = that.buffers;
-    this->headers = that.headers;
-    this->status  = that.status;
+    this->head    = that.head;
+    // Buffers point into that, regenerate from the copies
+    this->buffers.clear();
+    this->headers     = that.headers;
+    this->status      = that.status;
+    this->notModified = that.notModified;
+    this->ranges      = that.ranges;
+    this->stream      = that.stream;
   }
   return *this;
 }
@@ -64,13 +61,16 @@ void Reply::setStatus(Status_t httpStatus) {
 
 /**
  * @brief Add the Connection header based on keepAlive
+ * A persistent connection also advertises how long it is kept idle
  *
  * @param keepAlive adds "keep-alive" if true, "close" otherwise
+ * @param timeout in seconds the idle connection is kept open
  */
-void Reply::setKeepAlive(bool keepAlive) {
-  if (keepAlive)
+void Reply::setKeepAlive(bool keepAlive, std::chrono::seconds timeout) {
+  if (keepAlive) {
     addHeader("Connection", "keep-alive");
-  else
+    addHeader("Keep-Alive", "timeout=" + std::to_string(timeout.count()));
+  } else
     addHeader("Connection", "close");
 }
 
@@ -94,43 +94,236 @@ void Reply::appendContent(std::string string) {
 }
 
 /**
- * @brief Set the content to a file
- * file will be closed after it is written or connection closes
+ * @brief Set the content to an asset, its headers are added before the others
+ * The asset is held until the reply is destroyed
  *
- * @param contentFile to set
+ * @param contentAsset to set
  */
-void Reply::setContent(MemoryMapped * contentFile) {
-  file = contentFile;
+void Reply::setContent(AssetPtr_t contentAsset) {
+  asset = std::move(contentAsset);
+}
+
+/**
+ * @brief Reply 304 Not Modified for an asset, only its validators and caching
+ * headers are sent without a body
+ *
+ * @param contentAsset the client already has
+ */
+void Reply::setNotModified(AssetPtr_t contentAsset) {
+  status      = Status_t::NOT_MODIFIED;
+  asset       = std::move(contentAsset);
+  notModified = true;
+}
+
+/**
+ * @brief Reply 206 Partial Content with ranges of the asset
+ * A single range is sent as is, several as multipart/byteranges
+ *
+ * @param contentRanges of the asset, satisfiable and clipped to its size
+ */
+void Reply::setRanges(const std::vector<ByteRange_t> & contentRanges) {
+  status = Status_t::PARTIAL_CONTENT;
+  ranges = contentRanges;
+}
+
+/**
+ * @brief Set the content to a stream, sent with chunked transfer encoding
+ * Its first chunk must be produced, the next once that one has been sent. The
+ * stream's headers are added by the caller
+ *
+ * @param contentStream to set
+ */
+void Reply::setStream(std::shared_ptr<EBStream> contentStream) {
+  stream = std::move(contentStream);
+}
+
+/**
+ * @brief Compress the content string if the client accepts gzip
+ * Only cached assets are compressed off the workers, generated content is
+ * gzipped here on the worker, the compressor's minimum size keeps small
+ * replies as is. Content already encoded is left alone. Compressible content
+ * varies on Accept-Encoding whether or not this client gets it compressed
+ *
+ * @param requestHeaders of the request, for its accepted encodings
+ * @param compressor of the server
+ */
+void Reply::compress(
+    const RequestHeaders & requestHeaders, Compressor & compressor) {
+  if (content.empty() || !compressor.isCompressible(content.size()) ||
+      hasHeader("Content-Encoding"))
+    return;
+  addHeader("Vary", "Accept-Encoding");
+  if (!requestHeaders.acceptsEncoding(RequestHeaders::Encoding_t::GZIP))
+    return;
+
+  std::string compressed;
+  Result      result = compressor.gzip(
+      reinterpret_cast<const uint8_t *>(content.data()), content.size(),
+      compressed);
+  if (!result || compressed.size() >= content.size())
+    return;
+  content.swap(compressed);
+  for (Header_t & header : headers) {
+    if (header.name == "Content-Length")
+      header.value = std::to_string(content.size());
+  }
+  addHeader("Content-Encoding", "gzip");
 }
 
 /**
  * @brief Get the next set of buffers ready to send
+ * The status line and headers are serialized into one buffer, followed by the
+ * content, so the reply is gathered into a single write
  *
  * @return std::vector<asio::const_buffer> buffers
  */
 const std::vector<asio::const_buffer> & Reply::getBuffers() {
   // If the buffers vector is empty, populate first
   if (buffers.empty()) {
-    buffers.clear();
-    buffers.push_back(statusToBuffer());
-    buffers.push_back(asio::buffer(STRING_CRLF));
-    for (size_t i = 0; i < headers.size(); ++i) {
-      Header_t & header = headers[i];
-      buffers.push_back(asio::buffer(header.name));
-      buffers.push_back(asio::buffer(STRING_NAME_VALUE_SEPARATOR));
-      buffers.push_back(asio::buffer(header.value));
-      buffers.push_back(asio::buffer(STRING_CRLF));
+    head = statusToString();
+    head += STRING_CRLF;
+    if (!ranges.empty())
+      serializeRanges();
+    else if (notModified)
+      head += asset->headersNotModified;
+    else if (asset != nullptr)
+      head += asset->headers;
+    else if (stream != nullptr && stream->isFramed())
+      head += "Transfer-Encoding: chunked" + STRING_CRLF;
+    for (const Header_t & header : headers) {
+      head += header.name;
+      head += STRING_NAME_VALUE_SEPARATOR;
+      head += header.value;
+      head += STRING_CRLF;
     }
-    buffers.push_back(asio::buffer(STRING_CRLF));
-    if (!content.empty())
+    head += STRING_CRLF;
+    buffers.push_back(asio::buffer(head));
+    if (!ranges.empty()) {
+      for (size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges.size() > 1)
+          buffers.push_back(asio::buffer(partHeads[i]));
+        buffers.push_back(asio::buffer(asset->data + ranges[i].first,
+            ranges[i].last - ranges[i].first + 1));
+      }
+      if (ranges.size() > 1)
+        buffers.push_back(asio::buffer(partHeads.back()));
+    } else if (stream != nullptr)
+      buffers.push_back(asio::buffer(stream->getChunk()));
+    else if (!content.empty())
       buffers.push_back(asio::buffer(content));
-    else if (file != nullptr)
-      buffers.push_back(
-          asio::buffer(file->getData(), static_cast<size_t>(file->size())));
+    else if (asset != nullptr && asset->size != 0 && !notModified)
+      buffers.push_back(asio::buffer(asset->data, asset->size));
   }
   return buffers;
 }
 
+/**
+ * @brief Produce the next chunk of a stream once the previous one was sent
+ * The buffers are replaced by the new chunk
+ *
+ * @return Result error code
+ */
+Result Reply::produce() {
+  Result result = stream->produce();
+  if (!result)
+    return result;
+  buffers.clear();
+  buffers.push_back(asio::buffer(stream->getChunk()));
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Check if the reply is a stream with chunks yet to be produced
+ *
+ * @return true if the stream has not finished
+ * @return false otherwise
+ */
+bool Reply::isStreaming() const {
+  return stream != nullptr && !stream->isFinished();
+}
+
+/**
+ * @brief Check if the reply's body ends when the connection closes
+ *
+ * @return true if the reply is a stream without chunked framing
+ * @return false otherwise
+ */
+bool Reply::isEndedByClose() const {
+  return stream != nullptr && stream->isChunked() && !stream->isFramed();
+}
+
+/**
+ * @brief Get the file a buffer of the reply's body can be sent from
+ *
+ * @param buffer of the reply
+ * @param fd descriptor to return
+ * @param offset of the buffer in the file to return
+ * @return true if the buffer is backed by the asset's file
+ * @return false otherwise
+ */
+bool Reply::getFile(
+    const asio::const_buffer & buffer, int & fd, uint64_t & offset) const {
+  return asset != nullptr && !notModified &&
+         asset->getFile(buffer.data(), fd, offset);
+}
+
+/**
+ * @brief Serialize the entity headers of a range reply into the head
+ * Several ranges are separated by part heads, each with its own
+ * Content-Range, and the body's length includes them
+ *
+ */
+void Reply::serializeRanges() {
+  const std::string size = "/" + std::to_string(asset->size) + STRING_CRLF;
+  if (ranges.size() == 1) {
+    const ByteRange_t & range = ranges.front();
+    head += "Content-Type: " + asset->type + STRING_CRLF;
+    head += "Content-Range: bytes " + std::to_string(range.first) + "-" +
+            std::to_string(range.last) + size;
+    head += "Content-Length: " +
+            std::to_string(range.last - range.first + 1) + STRING_CRLF;
+    head += asset->headersNotModified;
+    return;
+  }
+
+  size_t length = 0;
+  partHeads.clear();
+  for (const ByteRange_t & range : ranges) {
+    partHeads.push_back(STRING_CRLF + "--" + STRING_BOUNDARY + STRING_CRLF +
+                        "Content-Type: " + asset->type + STRING_CRLF +
+                        "Content-Range: bytes " + std::to_string(range.first) +
+                        "-" + std::to_string(range.last) + size + STRING_CRLF);
+    length += partHeads.back().size() + range.last - range.first + 1;
+  }
+  partHeads.push_back(
+      STRING_CRLF + "--" + STRING_BOUNDARY + "--" + STRING_CRLF);
+  length += partHeads.back().size();
+
+  head += "Content-Type: multipart/byteranges; boundary=" + STRING_BOUNDARY +
+          STRING_CRLF;
+  head += "Content-Length: " + std::to_string(length) + STRING_CRLF;
+  head += asset->headersNotModified;
+}
+
+/**
+ * @brief Check if a header was added, names are case-insensitive
+ *
+ * @param name of the header
+ * @return true if the header is present
+ * @return false otherwise
+ */
+bool Reply::hasHeader(const std::string & name) const {
+  for (const Header_t & header : headers) {
+    if (header.name.size() == name.size() &&
+        std::equal(name.begin(), name.end(), header.name.begin(),
+            [](unsigned char a, unsigned char b) {
+              return tolower(a) == tolower(b);
+            }))
+      return true;
+  }
+  return false;
+}
+
 /**
  * @brief Generate a stock reply from the HTTP status
  *
@@ -153,6 +346,9 @@ Reply Reply::stockReply(Status_t httpStatus) {
     case Status_t::NO_CONTENT:
       reply.appendContent(StockReply::NO_CONTENT);
       break;
+    case Status_t::PARTIAL_CONTENT:
+      reply.appendContent(StockReply::PARTIAL_CONTENT);
+      break;
     case Status_t::MULTIPLE_CHOICES:
       reply.appendContent(StockReply::MULTIPLE_CHOICES);
       break;
@@ -177,6 +373,12 @@ Reply Reply::stockReply(Status_t httpStatus) {
     case Status_t::NOT_FOUND:
       reply.appendContent(StockReply::NOT_FOUND);
       break;
+    case Status_t::PAYLOAD_TOO_LARGE:
+      reply.appendContent(StockReply::PAYLOAD_TOO_LARGE);
+      break;
+    case Status_t::RANGE_NOT_SATISFIABLE:
+      reply.appendContent(StockReply::RANGE_NOT_SATISFIABLE);
+      break;
     case Status_t::INTERNAL_SERVER_ERROR:
     default:
       reply.appendContent(StockReply::INTERNAL_SERVER_ERROR);
@@ -219,47 +421,53 @@ Reply Reply::stockReply(Result result) {
 }
 
 /**
- * @brief Transform a HTTP status into its string as a buffer
+ * @brief Transform a HTTP status into its string
  *
- * @return asio::const_buffer output string
+ * @return const std::string & status line
  */
-asio::const_buffer Reply::statusToBuffer() {
+const std::string & Reply::statusToString() {
   switch (status) {
     case Status_t::SWITCHING_PROTOCOLS:
-      return asio::buffer(StatusString::SWITCHING_PROTOCOLS);
+      return StatusString::SWITCHING_PROTOCOLS;
     case Status_t::OK:
-      return asio::buffer(StatusString::OK);
+      return StatusString::OK;
     case Status_t::CREATED:
-      return asio::buffer(StatusString::CREATED);
+      return StatusString::CREATED;
     case Status_t::ACCEPTED:
-      return asio::buffer(StatusString::ACCEPTED);
+      return StatusString::ACCEPTED;
     case Status_t::NO_CONTENT:
-      return asio::buffer(StatusString::NO_CONTENT);
+      return StatusString::NO_CONTENT;
+    case Status_t::PARTIAL_CONTENT:
+      return StatusString::PARTIAL_CONTENT;
     case Status_t::MULTIPLE_CHOICES:
-      return asio::buffer(StatusString::MULTIPLE_CHOICES);
+      return StatusString::MULTIPLE_CHOICES;
     case Status_t::MOVED_PERMANENTLY:
-      return asio::buffer(StatusString::MOVED_PERMANENTLY);
+      return StatusString::MOVED_PERMANENTLY;
     case Status_t::MOVED_TEMPORARILY:
-      return asio::buffer(StatusString::MOVED_TEMPORARILY);
+      return StatusString::MOVED_TEMPORARILY;
     case Status_t::NOT_MODIFIED:
-      return asio::buffer(StatusString::NOT_MODIFIED);
+      return StatusString::NOT_MODIFIED;
     case Status_t::BAD_REQUEST:
-      return asio::buffer(StatusString::BAD_REQUEST);
+      return StatusString::BAD_REQUEST;
     case Status_t::UNAUTHORIZED:
-      return asio::buffer(StatusString::UNAUTHORIZED);
+      return StatusString::UNAUTHORIZED;
     case Status_t::FORBIDDEN:
-      return asio::buffer(StatusString::FORBIDDEN);
+      return StatusString::FORBIDDEN;
     case Status_t::NOT_FOUND:
-      return asio::buffer(StatusString::NOT_FOUND);
+      return StatusString::NOT_FOUND;
+    case Status_t::PAYLOAD_TOO_LARGE:
+      return StatusString::PAYLOAD_TOO_LARGE;
+    case Status_t::RANGE_NOT_SATISFIABLE:
+      return StatusString::RANGE_NOT_SATISFIABLE;
     case Status_t::INTERNAL_SERVER_ERROR:
     default:
-      return asio::buffer(StatusString::INTERNAL_SERVER_ERROR);
+      return StatusString::INTERNAL_SERVER_ERROR;
     case Status_t::NOT_IMPLEMENTED:
-      return asio::buffer(StatusString::NOT_IMPLEMENTED);
+      return StatusString::NOT_IMPLEMENTED;
     case Status_t::BAD_GATEWAY:
-      return asio::buffer(StatusString::BAD_GATEWAY);
+      return StatusString::BAD_GATEWAY;
     case Status_t::SERVICE_UNAVAILABLE:
-      return asio::buffer(StatusString::SERVICE_UNAVAILABLE);
+      return StatusString::SERVICE_UNAVAILABLE;
   }
 }
 
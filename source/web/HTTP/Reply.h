@@ -1,10 +1,16 @@
 #ifndef _WEB_REPLY_H_
 #define _WEB_REPLY_H_
 
+#include "AssetCache.h"
+#include "Compressor.h"
+#include "RequestHeaders.h"
+#include "Stream.h"
+
 #include <FruitBowl.h>
-#include <MemoryMapped.h>
 #include <asio.hpp>
 
+#include <chrono>
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -19,6 +25,7 @@ enum class Status_t : uint16_t {
   CREATED               = 201,
   ACCEPTED              = 202,
   NO_CONTENT            = 204,
+  PARTIAL_CONTENT       = 206,
   MULTIPLE_CHOICES      = 300,
   MOVED_PERMANENTLY     = 301,
   MOVED_TEMPORARILY     = 302,
@@ -27,6 +34,8 @@ enum class Status_t : uint16_t {
   UNAUTHORIZED          = 401,
   FORBIDDEN             = 403,
   NOT_FOUND             = 404,
+  PAYLOAD_TOO_LARGE     = 413,
+  RANGE_NOT_SATISFIABLE = 416,
   INTERNAL_SERVER_ERROR = 500,
   NOT_IMPLEMENTED       = 501,
   BAD_GATEWAY           = 502,
@@ -35,23 +44,26 @@ enum class Status_t : uint16_t {
 
 namespace StatusString {
 // clang-format off
-const std::string SWITCHING_PROTOCOLS   = "HTTP/1.0 101 Switching Protocols";
-const std::string OK                    = "HTTP/1.0 200 OK";
-const std::string CREATED               = "HTTP/1.0 201 Created";
-const std::string ACCEPTED              = "HTTP/1.0 202 Accepted";
-const std::string NO_CONTENT            = "HTTP/1.0 204 No Content";
-const std::string MULTIPLE_CHOICES      = "HTTP/1.0 300 Multiple Choices";
-const std::string MOVED_PERMANENTLY     = "HTTP/1.0 301 Moved Permanently";
-const std::string MOVED_TEMPORARILY     = "HTTP/1.0 302 Moved Temporarily";
-const std::string NOT_MODIFIED          = "HTTP/1.0 304 Not Modified";
-const std::string BAD_REQUEST           = "HTTP/1.0 400 Bad Request";
-const std::string UNAUTHORIZED          = "HTTP/1.0 401 Unauthorized";
-const std::string FORBIDDEN             = "HTTP/1.0 403 Forbidden";
-const std::string NOT_FOUND             = "HTTP/1.0 404 Not Found";
-const std::string INTERNAL_SERVER_ERROR = "HTTP/1.0 500 Internal Server Error";
-const std::string NOT_IMPLEMENTED       = "HTTP/1.0 501 Not Implemented";
-const std::string BAD_GATEWAY           = "HTTP/1.0 502 Bad Gateway";
-const std::string SERVICE_UNAVAILABLE   = "HTTP/1.0 503 Service Unavailable";
+const std::string SWITCHING_PROTOCOLS   = "HTTP/1.1 101 Switching Protocols";
+const std::string OK                    = "HTTP/1.1 200 OK";
+const std::string CREATED               = "HTTP/1.1 201 Created";
+const std::string ACCEPTED              = "HTTP/1.1 202 Accepted";
+const std::string NO_CONTENT            = "HTTP/1.1 204 No Content";
+const std::string PARTIAL_CONTENT       = "HTTP/1.1 206 Partial Content";
+const std::string MULTIPLE_CHOICES      = "HTTP/1.1 300 Multiple Choices";
+const std::string MOVED_PERMANENTLY     = "HTTP/1.1 301 Moved Permanently";
+const std::string MOVED_TEMPORARILY     = "HTTP/1.1 302 Moved Temporarily";
+const std::string NOT_MODIFIED          = "HTTP/1.1 304 Not Modified";
+const std::string BAD_REQUEST           = "HTTP/1.1 400 Bad Request";
+const std::string UNAUTHORIZED          = "HTTP/1.1 401 Unauthorized";
+const std::string FORBIDDEN             = "HTTP/1.1 403 Forbidden";
+const std::string NOT_FOUND             = "HTTP/1.1 404 Not Found";
+const std::string PAYLOAD_TOO_LARGE     = "HTTP/1.1 413 Payload Too Large";
+const std::string RANGE_NOT_SATISFIABLE = "HTTP/1.1 416 Range Not Satisfiable";
+const std::string INTERNAL_SERVER_ERROR = "HTTP/1.1 500 Internal Server Error";
+const std::string NOT_IMPLEMENTED       = "HTTP/1.1 501 Not Implemented";
+const std::string BAD_GATEWAY           = "HTTP/1.1 502 Bad Gateway";
+const std::string SERVICE_UNAVAILABLE   = "HTTP/1.1 503 Service Unavailable";
 // clang-format on
 } // namespace StatusString
 
@@ -77,6 +89,11 @@ const std::string NO_CONTENT =
     "<head><title>No Content</title></head>"
     "<body><h1>204 No Content</h1></body>"
     "</html>";
+const std::string PARTIAL_CONTENT =
+    "<html>"
+    "<head><title>Partial Content</title></head>"
+    "<body><h1>206 Partial Content</h1></body>"
+    "</html>";
 const std::string MULTIPLE_CHOICES =
     "<html>"
     "<head><title>Multiple Choices</title></head>"
@@ -117,6 +134,16 @@ const std::string NOT_FOUND =
     "<head><title>Not Found</title></head>"
     "<body><h1>404 Not Found</h1></body>"
     "</html>";
+const std::string PAYLOAD_TOO_LARGE =
+    "<html>"
+    "<head><title>Payload Too Large</title></head>"
+    "<body><h1>413 Payload Too Large</h1></body>"
+    "</html>";
+const std::string RANGE_NOT_SATISFIABLE =
+    "<html>"
+    "<head><title>Range Not Satisfiable</title></head>"
+    "<body><h1>416 Range Not Satisfiable</h1></body>"
+    "</html>";
 const std::string INTERNAL_SERVER_ERROR =
     "<html>"
     "<head><title>Internal Server Error</title></head>"
@@ -142,6 +169,7 @@ const std::string SERVICE_UNAVAILABLE =
 
 const std::string STRING_CRLF                 = "\r\n";
 const std::string STRING_NAME_VALUE_SEPARATOR = ": ";
+const std::string STRING_BOUNDARY             = "EhbananaByteRanges";
 
 struct Header_t {
   std::string name;
@@ -156,24 +184,41 @@ public:
   Reply & operator=(const Reply & that);
 
   void setStatus(Status_t httpStatus);
-  void setKeepAlive(bool keepAlive);
+  void setKeepAlive(bool keepAlive, std::chrono::seconds timeout);
   void addHeader(const std::string & name, const std::string & value);
   void appendContent(std::string string);
-  void setContent(MemoryMapped * contentFile);
+  void setContent(AssetPtr_t contentAsset);
+  void setNotModified(AssetPtr_t contentAsset);
+  void setRanges(const std::vector<ByteRange_t> & contentRanges);
+  void setStream(std::shared_ptr<EBStream> contentStream);
+  void compress(
+      const RequestHeaders & requestHeaders, Compressor & compressor);
 
   const std::vector<asio::const_buffer> & getBuffers();
+  Result                                  produce();
+  bool                                    isStreaming() const;
+  bool                                    isEndedByClose() const;
+  bool getFile(
+      const asio::const_buffer & buffer, int & fd, uint64_t & offset) const;
 
   static Reply stockReply(Status_t httpStatus);
   static Reply stockReply(Result result);
 
 private:
-  asio::const_buffer statusToBuffer();
+  const std::string & statusToString();
+  void                serializeRanges();
+  bool                hasHeader(const std::string & name) const;
 
-  MemoryMapped *                  file;
+  AssetPtr_t                      asset;
   std::string                     content;
+  std::string                     head;
+  std::vector<ByteRange_t>        ranges;
+  std::vector<std::string>        partHeads;
+  std::shared_ptr<EBStream>       stream;
   std::vector<asio::const_buffer> buffers;
   std::vector<Header_t>           headers;
-  Status_t                        status = Status_t::OK;
+  Status_t                        status      = Status_t::OK;
+  bool                            notModified = false;
 };
 
 } // namespace HTTP
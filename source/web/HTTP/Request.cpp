@@ -1,8 +1,13 @@
 #include "Request.h"
 
+#include "Router.h"
+#include "Stream.h"
+
 #include "EhbananaLog.h"
 
+#include <algorithm>
 #include <sstream>
+#include <string.h>
 
 namespace Ehbanana {
 namespace Web {
@@ -11,8 +16,10 @@ namespace HTTP {
 /**
  * @brief Construct a new Request:: Request object
  *
+ * @param router of the server, to route the request once its headers are
+ * parsed
  */
-Request::Request() {}
+Request::Request(const Router * router) : router(router) {}
 
 /**
  * @brief Destroy the Request:: Request object
@@ -23,160 +30,313 @@ Request::~Request() {}
 /**
  * @brief Parse a string and add its contents to the request
  *
- * The string may be a fragment of the entire request
+ * The string may be a fragment of the entire request. Lines are found with
+ * memchr and their tokens hashed straight from the string, only a line split
+ * between fragments is copied. The body is passed to the routed stream as it
+ * arrives, an unrouted body is discarded. A chunked body is decoded on the
+ * way, only its chunks' data is passed
  *
- * @param begin character pointer
+ * Stops at the end of the request, bytes after it belong to the next
+ * pipelined request
+ *
+ * @param begin character pointer, advanced past the bytes consumed
  * @param end character pointer
- * @return Result error code
+ * @return Result error code, SUCCESS once the request is complete or its body
+ * is rejected without being read
  */
-Result Request::parse(const uint8_t * begin, const uint8_t * end) {
+Result Request::parse(const uint8_t *& begin, const uint8_t * end) {
   Result result;
-  // For every character in the array, add it to the appropriate field based on
-  // the current parsing state
-  while (begin != end) {
-    result = parse(*begin);
-    if (!result) {
-      return result + "Parsing request character";
+  for (;;) {
+    if (state == State_t::DONE)
+      return ResultCode_t::SUCCESS;
+    if (state == State_t::BODY || state == State_t::CHUNK) {
+      receiveBody(begin, end);
+      if (state == State_t::BODY || state == State_t::CHUNK)
+        return ResultCode_t::INCOMPLETE;
+      continue;
+    }
+    if (begin == end)
+      return ResultCode_t::INCOMPLETE;
+
+    const uint8_t * newline = static_cast<const uint8_t *>(
+        memchr(begin, '\n', static_cast<size_t>(end - begin)));
+    if (newline == nullptr) {
+      // Line continues in the next fragment
+      line.append(begin, end);
+      begin = end;
+      if (line.size() > LINE_SIZE_MAX)
+        return ResultCode_t::BUFFER_OVERFLOW + "Request line is too long";
+      return ResultCode_t::INCOMPLETE;
+    }
+
+    const uint8_t * lineBegin = begin;
+    const uint8_t * lineEnd   = newline;
+    if (!line.empty()) {
+      line.append(begin, newline);
+      lineBegin = reinterpret_cast<const uint8_t *>(line.data());
+      lineEnd   = lineBegin + line.size();
     }
+    if (lineEnd != lineBegin && *(lineEnd - 1) == '\r')
+      --lineEnd;
+
+    if (state == State_t::IDLE)
+      result = parseRequestLine(lineBegin, lineEnd);
+    else if (state == State_t::HEADERS)
+      result = parseHeaderLine(lineBegin, lineEnd);
+    else
+      result = parseChunkLine(lineBegin, lineEnd);
+    if (!result)
+      return result + "Parsing request line";
+    line.clear();
+    begin = newline + 1;
+  }
+}
+
+/**
+ * @brief Parse the request line: method, URI with queries and HTTP version
+ *
+ * @param begin character pointer
+ * @param end character pointer, excluding the line ending
+ * @return Result error code
+ */
+Result Request::parseRequestLine(const uint8_t * begin, const uint8_t * end) {
+  // Blank lines may separate pipelined requests
+  if (begin == end)
+    return ResultCode_t::SUCCESS;
+
+  Result          result;
+  const uint8_t * space = find(begin, end, ' ');
+  if (space == end)
+    return ResultCode_t::BAD_COMMAND + "Request line is missing a URI";
+  add(method, begin, space);
+  result = validateMethod();
+  if (!result)
+    return result + "Validating request method";
+
+  begin = space + 1;
+  space = find(begin, end, ' ');
+  if (space == end)
+    return ResultCode_t::BAD_COMMAND + "Request line is missing a version";
+  const uint8_t * question = find(begin, space, '?');
+  add(uri, begin, question);
+  result = decodeURI(uri);
+  if (!result)
+    return result + "Decoding request URI";
+
+  begin = question;
+  while (begin != space) {
+    // Skip the '?' or '&' before each query
     ++begin;
+    const uint8_t * ampersand = find(begin, space, '&');
+    const uint8_t * equals    = find(begin, ampersand, '=');
+    queries.push_back(HeaderHash_t());
+    HeaderHash_t & query = queries.back();
+    add(query.name, begin, equals);
+    result = decodeURI(query.name);
+    if (!result)
+      return result + "Decoding request URI of query name";
+    if (equals != ampersand) {
+      add(query.value, equals + 1, ampersand);
+      result = decodeURI(query.value);
+      if (!result)
+        return result + "Decoding request URI of query value";
+    }
+    query.value.setDone(true);
+    begin = ampersand;
   }
-  if (state == State_t::BODY && headers.getContentLength() == body.size())
+
+  add(httpVersion, space + 1, end);
+  result = validateHTTPVersion();
+  if (!result)
+    return result + "Validating request HTTP version";
+
+  state = State_t::HEADERS;
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Parse a header line, the blank line ends the headers
+ *
+ * @param begin character pointer
+ * @param end character pointer, excluding the line ending
+ * @return Result error code
+ */
+Result Request::parseHeaderLine(const uint8_t * begin, const uint8_t * end) {
+  if (begin == end) {
+    beginBody();
     return ResultCode_t::SUCCESS;
-  else if (body.size() > headers.getContentLength())
-    return ResultCode_t::BUFFER_OVERFLOW +
-           "Request body size is longer than content length";
-  else
-    return ResultCode_t::INCOMPLETE;
+  }
+
+  const uint8_t * colon = find(begin, end, ':');
+  if (colon == end)
+    return ResultCode_t::BAD_COMMAND + "Request header is missing a ':'";
+  HeaderHash_t header;
+  add(header.name, begin, colon);
+
+  // Trim the whitespace around the value
+  begin = colon + 1;
+  while (begin != end && (*begin == ' ' || *begin == '\t'))
+    ++begin;
+  while (end != begin && (*(end - 1) == ' ' || *(end - 1) == '\t'))
+    --end;
+  add(header.value, begin, end);
+
+  Result result = headers.addHeader(header);
+  if (result == ResultCode_t::UNKNOWN_HASH)
+    warn(result.getMessage());
+  else if (!result)
+    return result + "Adding request header";
+  return ResultCode_t::SUCCESS;
 }
 
 /**
- * @brief Parse a single character into the request
+ * @brief Parse a line of a chunked body: the size of the next chunk, the line
+ * ending after a chunk's data or a trailer field
+ * Chunk extensions and trailer fields are ignored, the blank line after the
+ * last chunk ends the body
  *
- * @param c character to parse
+ * @param begin character pointer
+ * @param end character pointer, excluding the line ending
  * @return Result error code
  */
-Result Request::parse(uint8_t c) {
-  Result result;
-  switch (state) {
-    case State_t::IDLE:
-      state = State_t::METHOD;
-      // Fall through
-    case State_t::METHOD:
-      if (c == ' ') {
-        state  = State_t::URI;
-        result = validateMethod();
-        if (!result)
-          return result + "Validating request method";
-      } else
-        method.add(c);
-      break;
-    case State_t::URI:
-      if (c == ' ') {
-        state  = State_t::HTTP_VERSION;
-        result = decodeURI(uri);
-        if (!result)
-          return result + "Decoding request URI";
-      } else if (c == '?') {
-        state  = State_t::QUERY_NAME;
-        result = decodeURI(uri);
-        if (!result)
-          return result + "Decoding request URI";
-      } else
-        uri.add(c);
-      break;
-    case State_t::QUERY_NAME: {
-      // If there are no queries or the last query is already complete, add a
-      // new one
-      if (queries.empty() || queries.back().value.isDone())
-        queries.push_back(HeaderHash_t());
-      HeaderHash_t & query = queries.back();
-      if (c == '=') {
-        state  = State_t::QUERY_VALUE;
-        result = decodeURI(query.name);
-        if (!result)
-          return result + "Decoding request URI of query name";
-      } else if (c == ' ') {
-        // Valueless query
-        state  = State_t::HTTP_VERSION;
-        result = decodeURI(query.name);
-        if (!result)
-          return result + "Decoding request URI of query name";
-      } else
-        query.name.add(c);
-
-    } break;
-    case State_t::QUERY_VALUE: {
-      HeaderHash_t & query = queries.back();
-      if (c == ' ') {
-        state  = State_t::HTTP_VERSION;
-        result = decodeURI(query.value);
-        query.value.setDone(true);
-        if (!result)
-          return result + "Decoding request URI of query value";
-      } else if (c == '&') {
-        state  = State_t::QUERY_NAME;
-        result = decodeURI(query.value);
-        if (!result)
-          return result + "Decoding request URI of query value";
-      } else
-        query.value.add(c);
-    } break;
-    case State_t::HTTP_VERSION:
-      if (c == '\n') {
-        state  = State_t::HEADER_NAME;
-        result = validateHTTPVersion();
-        if (!result)
-          return result + "Validating request HTTP version";
-      } else if (c != '\r')
-        httpVersion.add(c);
-      break;
-    case State_t::HEADER_NAME: {
-      if (c == '\r') {
-        state = State_t::BODY_NEWLINE;
-        break;
-      }
-      // If there are no headers or the last header is already complete, add a
-      // new one
-      if (c == ' ') {
-        state = State_t::HEADER_VALUE;
-      } else if (c != ':')
-        currentHeader.name.add(c);
-    } break;
-    case State_t::HEADER_VALUE: {
-      if (c == '\n') {
-        state  = State_t::HEADER_NAME;
-        result = headers.addHeader(currentHeader);
-        if (result == ResultCode_t::UNKNOWN_HASH)
-          warn(result.getMessage());
-        else if (!result)
-          return result + "Adding request header";
-        currentHeader = HeaderHash_t();
-      } else if (c != '\r')
-        currentHeader.value.add(c);
-    } break;
-    case State_t::BODY_NEWLINE:
-      if (c == '\n') {
-        state = State_t::BODY;
-        body.reserve(headers.getContentLength());
-      } else
-        return ResultCode_t::BAD_COMMAND +
-               "Request is missing a blank new line after header";
-      break;
-    case State_t::BODY:
-      if (headers.getContentLength() == 0) {
-        log(EBLogLevel_t::EB_DEBUG, "Tried to add '%c' (0x%02X) to body", c, c);
-        return ResultCode_t::BAD_COMMAND +
-               "Request has body but zero content length";
-      }
-      body += c;
+Result Request::parseChunkLine(const uint8_t * begin, const uint8_t * end) {
+  if (state == State_t::CHUNK_END) {
+    if (begin != end)
+      return ResultCode_t::INVALID_DATA + "Chunk is longer than its size";
+    state = State_t::CHUNK_SIZE;
+    return ResultCode_t::SUCCESS;
+  }
+  if (state == State_t::TRAILER) {
+    if (begin == end)
+      endBody();
+    return ResultCode_t::SUCCESS;
+  }
+
+  size_t          size = 0;
+  const uint8_t * i    = begin;
+  for (; i != end; ++i) {
+    uint8_t digit;
+    if (*i >= '0' && *i <= '9')
+      digit = *i - '0';
+    else if (*i >= 'a' && *i <= 'f')
+      digit = *i - 'a' + 10;
+    else if (*i >= 'A' && *i <= 'F')
+      digit = *i - 'A' + 10;
+    else
       break;
-    default:
-      return ResultCode_t::INVALID_STATE +
-             ("Request parsing is in state #" + static_cast<uint8_t>(state));
+    if (size > (SIZE_MAX >> 4))
+      return ResultCode_t::BUFFER_OVERFLOW + "Chunk size";
+    size = (size << 4) | digit;
+  }
+  if (i == begin || (i != end && *i != ';' && *i != ' ' && *i != '\t'))
+    return ResultCode_t::INVALID_DATA + "Chunk size is not hex";
+
+  if (size == 0)
+    state = State_t::TRAILER;
+  else if (size > Body::getSizeMax() - bodyReceived) {
+    // The rest of the body is not read, the connection closes after the reply
+    bodyTooLarge = true;
+    state        = State_t::DONE;
+  } else {
+    bodyRemaining = size;
+    state         = State_t::CHUNK;
   }
   return ResultCode_t::SUCCESS;
 }
 
+/**
+ * @brief Prepare for the body once the headers are parsed
+ * A routed request's stream is made now to receive the body as it arrives. A
+ * body that is too large or has an unsupported transfer coding is rejected
+ * without being read
+ *
+ */
+void Request::beginBody() {
+  RequestHeaders::TransferEncoding_t encoding = headers.getTransferEncoding();
+  if (encoding == RequestHeaders::TransferEncoding_t::NOT_SUPPORTED) {
+    bodyNotSupported = true;
+    state            = State_t::DONE;
+    return;
+  }
+  if (encoding == RequestHeaders::TransferEncoding_t::CHUNKED)
+    state = State_t::CHUNK_SIZE;
+  else if (headers.getContentLength() > Body::getSizeMax()) {
+    bodyTooLarge = true;
+    state        = State_t::DONE;
+    return;
+  } else {
+    state         = State_t::BODY;
+    bodyRemaining = headers.getContentLength();
+  }
+
+  if (headers.getConnection() == RequestHeaders::Connection_t::UPGRADE)
+    return;
+  Route_t route = router->getRoute(method.getString(), uri.getString());
+  if (route.process == nullptr)
+    return;
+  stream = std::make_shared<EBStream>(route, *this);
+  stream->openBody(headers);
+}
+
+/**
+ * @brief Receive the bytes of the body or of the current chunk
+ *
+ * @param begin character pointer, advanced past the bytes consumed
+ * @param end character pointer
+ */
+void Request::receiveBody(const uint8_t *& begin, const uint8_t * end) {
+  size_t length = std::min(bodyRemaining, static_cast<size_t>(end - begin));
+  if (stream != nullptr && length != 0)
+    stream->receive(begin, length);
+  bodyReceived += length;
+  bodyRemaining -= length;
+  begin += length;
+  if (bodyRemaining != 0)
+    return;
+  if (state == State_t::CHUNK)
+    state = State_t::CHUNK_END;
+  else
+    endBody();
+}
+
+/**
+ * @brief Finish the body once it is received whole
+ *
+ */
+void Request::endBody() {
+  if (stream != nullptr)
+    stream->closeBody();
+  state = State_t::DONE;
+}
+
+/**
+ * @brief Find the first character in a span
+ *
+ * @param begin character pointer
+ * @param end character pointer
+ * @param c character to find
+ * @return const uint8_t * the character, end if not found
+ */
+const uint8_t * Request::find(
+    const uint8_t * begin, const uint8_t * end, char c) {
+  const void * found = memchr(begin, c, static_cast<size_t>(end - begin));
+  if (found == nullptr)
+    return end;
+  return static_cast<const uint8_t *>(found);
+}
+
+/**
+ * @brief Add a span of characters to a hash in one pass
+ *
+ * @param hash to add to
+ * @param begin character pointer
+ * @param end character pointer
+ */
+void Request::add(Hash & hash, const uint8_t * begin, const uint8_t * end) {
+  // Spans never contain a newline, the whole span is added
+  hash.add(begin, static_cast<size_t>(end - begin), '\n');
+}
+
 /**
  * @brief Checks the method is a valid HTTP request and supported
  *
@@ -186,11 +346,11 @@ Result Request::validateMethod() {
   switch (method.get()) {
     case Hash::calculateHash("GET"):
     case Hash::calculateHash("POST"):
+    case Hash::calculateHash("PUT"):
+    case Hash::calculateHash("DELETE"):
       return ResultCode_t::SUCCESS;
     case Hash::calculateHash("OPTIONS"):
     case Hash::calculateHash("HEAD"):
-    case Hash::calculateHash("PUT"):
-    case Hash::calculateHash("DELETE"):
     case Hash::calculateHash("TRACE"):
     case Hash::calculateHash("CONNECT"):
       return ResultCode_t::NOT_SUPPORTED + "Request method";
@@ -227,6 +387,15 @@ const RequestHeaders & Request::getHeaders() const {
   return headers;
 }
 
+/**
+ * @brief Get the stream of the routed request
+ *
+ * @return std::shared_ptr<EBStream> stream, nullptr if not routed
+ */
+std::shared_ptr<EBStream> Request::getStream() const {
+  return stream;
+}
+
 /**
  * @brief Get the state of parsing
  *
@@ -234,8 +403,60 @@ const RequestHeaders & Request::getHeaders() const {
  * @return false otherwise
  */
 bool Request::isParsing() {
-  return state != State_t::IDLE &&
-         (state != State_t::BODY || headers.getContentLength() != body.size());
+  return (state != State_t::IDLE || !line.empty()) && state != State_t::DONE;
+}
+
+/**
+ * @brief Check if the body is larger than accepted
+ * The body is not read, the connection closes after the reply
+ *
+ * @return true if the Content-Length, or the chunks so far, are over the
+ * limit
+ * @return false otherwise
+ */
+bool Request::isBodyTooLarge() const {
+  return bodyTooLarge;
+}
+
+/**
+ * @brief Check if the body has a transfer coding that is not supported
+ * The body is not read, the connection closes after the reply
+ *
+ * @return true if the Transfer-Encoding is not only chunked
+ * @return false otherwise
+ */
+bool Request::isBodyNotSupported() const {
+  return bodyNotSupported;
+}
+
+/**
+ * @brief Check if the body was rejected without being read
+ * Its bytes would be parsed as the next request, the connection must close
+ *
+ * @return true if the body is too large or its coding is not supported
+ * @return false otherwise
+ */
+bool Request::isBodyRejected() const {
+  return bodyTooLarge || bodyNotSupported;
+}
+
+/**
+ * @brief Check if the connection stays open after the reply
+ * HTTP/1.1 keeps the connection alive unless the request asks to close it,
+ * HTTP/1.0 closes it unless the request asks to keep it alive
+ *
+ * @return true if the connection is persistent
+ * @return false otherwise
+ */
+bool Request::isKeepAlive() const {
+  switch (headers.getConnection()) {
+    case RequestHeaders::Connection_t::KEEP_ALIVE:
+      return true;
+    case RequestHeaders::Connection_t::NOT_SET:
+      return httpVersion.get() == Hash::calculateHash("HTTP/1.1");
+    default:
+      return false;
+  }
 }
 
 /**
@@ -257,6 +478,15 @@ const Hash & Request::getURI() const {
   return uri;
 }
 
+/**
+ * @brief Get the HTTP version of the request
+ *
+ * @return const Hash& version, i.e. "HTTP/1.1"
+ */
+const Hash & Request::getHTTPVersion() const {
+  return httpVersion;
+}
+
 /**
  * @brief Get the queries of the request's URI
  * Uniform resource identifier
@@ -277,8 +507,11 @@ const std::vector<HeaderHash_t> & Request::getQueries() const {
 Result Request::decodeURI(Hash & uriHash) {
   Result              result;
   const std::string & string = uriHash.getString();
-  size_t              i      = 0;
-  Hash                uriDecoded;
+  // Most URIs have nothing to decode, keep the hash as is
+  if (string.find_first_of("%+") == std::string::npos)
+    return ResultCode_t::SUCCESS;
+  size_t i = 0;
+  Hash   uriDecoded;
   while (i < string.length()) {
     switch (string[i]) {
       case '%':
@@ -288,8 +521,8 @@ Result Request::decodeURI(Hash & uriHash) {
                  "URI has '%' but not enough characters";
         else {
           uint32_t    value = 0;
-          std::string hex   = string.substr(i, 2);
-          i += 2;
+          std::string hex   = string.substr(i + 1, 2);
+          i += 3;
 
           result = decodeHex(hex, value);
           if (!result)
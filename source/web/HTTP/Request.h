@@ -5,30 +5,50 @@
 
 #include <FruitBowl.h>
 
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
+struct EBStream;
+
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
 
+class Router;
+
 class Request {
 public:
-  Request();
+  Request(const Router * router);
   ~Request();
 
-  Result parse(const uint8_t * begin, const uint8_t * end);
+  Result parse(const uint8_t *& begin, const uint8_t * end);
 
   const Hash &                      getMethod() const;
   const Hash &                      getURI() const;
+  const Hash &                      getHTTPVersion() const;
   const std::vector<HeaderHash_t> & getQueries() const;
   const RequestHeaders &            getHeaders() const;
+  std::shared_ptr<EBStream>         getStream() const;
 
   bool isParsing();
+  bool isKeepAlive() const;
+  bool isBodyTooLarge() const;
+  bool isBodyNotSupported() const;
+  bool isBodyRejected() const;
 
 private:
-  Result parse(uint8_t c);
+  Result parseRequestLine(const uint8_t * begin, const uint8_t * end);
+  Result parseHeaderLine(const uint8_t * begin, const uint8_t * end);
+  Result parseChunkLine(const uint8_t * begin, const uint8_t * end);
+  void   beginBody();
+  void   receiveBody(const uint8_t *& begin, const uint8_t * end);
+  void   endBody();
+
+  static const uint8_t * find(
+      const uint8_t * begin, const uint8_t * end, char c);
+  static void add(Hash & hash, const uint8_t * begin, const uint8_t * end);
 
   Result validateMethod();
   Result validateHTTPVersion();
@@ -36,30 +56,42 @@ private:
   Result decodeURI(Hash & uriHash);
   Result decodeHex(const std::string & hex, uint32_t & value);
 
+  // A chunked body alternates between size lines and chunks, the trailer
+  // ends it
   enum class State_t : uint8_t {
     IDLE,
-    METHOD,
-    URI,
-    QUERY_NAME,
-    QUERY_VALUE,
-    HTTP_VERSION,
-    HEADER_NAME,
-    HEADER_VALUE,
-    BODY_NEWLINE,
-    BODY
+    HEADERS,
+    BODY,
+    CHUNK_SIZE,
+    CHUNK,
+    CHUNK_END,
+    TRAILER,
+    DONE
   };
 
   State_t state = State_t::IDLE;
 
+  // Longest line allowed to be split between fragments
+  static const size_t LINE_SIZE_MAX = 8192;
+
+  std::string line;
+
   Hash method;
   Hash uri;
   Hash httpVersion;
 
-  HeaderHash_t currentHeader;
-
-  std::string body;
   std::string endpoint;
 
+  // Of the server, a routed request's stream receives its body
+  const Router * router;
+
+  // The body is passed to the routed stream as it arrives, never kept here
+  size_t                    bodyReceived     = 0;
+  size_t                    bodyRemaining    = 0;
+  bool                      bodyTooLarge     = false;
+  bool                      bodyNotSupported = false;
+  std::shared_ptr<EBStream> stream;
+
   std::vector<HeaderHash_t> queries;
 
   RequestHeaders headers;
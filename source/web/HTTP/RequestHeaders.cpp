@@ -1,5 +1,9 @@
 #include "RequestHeaders.h"
 
+#include "Date.h"
+
+#include <algorithm>
+
 namespace Ehbanana {
 namespace Web {
 namespace HTTP {
@@ -21,10 +25,13 @@ Result RequestHeaders::addHeader(HeaderHash_t header) {
   Result result;
   switch (header.name.get()) {
     case Hash::calculateHash("Content-Length"):
-      contentLength = static_cast<size_t>(std::stoll(header.value.getString()));
+      return addContentLength(header);
+    case Hash::calculateHash("Content-Type"):
+      contentType = header.value.getString();
       break;
     case Hash::calculateHash("Connection"):
-      return addConnection(header);
+      addConnection(header);
+      break;
     case Hash::calculateHash("Upgrade"):
       return addUpgrade(header);
     case Hash::calculateHash("Sec-WebSocket-Key"):
@@ -33,11 +40,28 @@ Result RequestHeaders::addHeader(HeaderHash_t header) {
     case Hash::calculateHash("Sec-WebSocket-Version"):
       webSocketVersion = header.value;
       break;
+    case Hash::calculateHash("Accept-Encoding"):
+      addAcceptEncoding(header);
+      break;
+    case Hash::calculateHash("Transfer-Encoding"):
+      addTransferEncoding(header);
+      break;
+    case Hash::calculateHash("If-None-Match"):
+      ifNoneMatch = header.value.getString();
+      break;
+    case Hash::calculateHash("If-Modified-Since"):
+      ifModifiedSince = parseDate(header.value.getString());
+      break;
+    case Hash::calculateHash("If-Range"):
+      ifRange = header.value.getString();
+      break;
+    case Hash::calculateHash("Range"):
+      range = header.value.getString();
+      break;
     case Hash::calculateHash("Host"):
     case Hash::calculateHash("Upgrade-Insecure-Requests"):
     case Hash::calculateHash("User-Agent"):
     case Hash::calculateHash("Accept"):
-    case Hash::calculateHash("Accept-Encoding"):
     case Hash::calculateHash("Accept-Language"):
     case Hash::calculateHash("Referer"):
     case Hash::calculateHash("Cache-Control"):
@@ -57,28 +81,60 @@ Result RequestHeaders::addHeader(HeaderHash_t header) {
 }
 
 /**
- * @brief Add connection header
+ * @brief Add content length header
+ * Decimal digits only, a repeated header must have the same value
+ *
+ * Returns ResultCode_t::INVALID_DATA if the value is malformed, too large or
+ * conflicts with a previous one
  *
  * @param header to add
  * @return Result error code
  */
-Result RequestHeaders::addConnection(HeaderHash_t header) {
-  switch (header.value.get()) {
-    case Hash::calculateHash("close"):
+Result RequestHeaders::addContentLength(HeaderHash_t header) {
+  const std::string & value = header.value.getString();
+  // Lengths of at most 18 digits cannot overflow
+  if (value.empty() || value.size() > 18 ||
+      value.find_first_not_of("0123456789") != std::string::npos)
+    return ResultCode_t::INVALID_DATA + ("Content-Length: " + value);
+  size_t length = static_cast<size_t>(std::stoull(value));
+  if (contentLengthSet && length != contentLength)
+    return ResultCode_t::INVALID_DATA +
+           ("Conflicting Content-Length: " + value);
+  contentLength    = length;
+  contentLengthSet = true;
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Add connection header
+ * A comma separated list of options in any case, upgrade takes precedence
+ * over close and close over keep-alive. Other options are ignored
+ *
+ * @param header to add
+ */
+void RequestHeaders::addConnection(HeaderHash_t header) {
+  const std::string & value = header.value.getString();
+  size_t              begin = 0;
+  while (begin < value.size()) {
+    size_t end = value.find(',', begin);
+    if (end == std::string::npos)
+      end = value.size();
+    size_t first = value.find_first_not_of(" \t", begin);
+    size_t last  = value.find_last_not_of(" \t", end - 1);
+    begin        = end + 1;
+    if (first >= end || last == std::string::npos || last < first)
+      continue;
+
+    std::string option = value.substr(first, last + 1 - first);
+    std::transform(option.begin(), option.end(), option.begin(),
+        [](char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+    if (option == "upgrade")
+      connection = Connection_t::UPGRADE;
+    else if (option == "close" && connection != Connection_t::UPGRADE)
       connection = Connection_t::CLOSE;
-      break;
-    case Hash::calculateHash("Keep-Alive"):
-    case Hash::calculateHash("keep-alive"):
+    else if (option == "keep-alive" && connection == Connection_t::NOT_SET)
       connection = Connection_t::KEEP_ALIVE;
-      break;
-    case Hash::calculateHash("Upgrade"):
-      connection = Connection_t::UPGRADE;
-      break;
-    default:
-      return ResultCode_t::UNKNOWN_HASH +
-             ("Request header Connection: " + header.value.getString());
   }
-  return ResultCode_t::SUCCESS;
 }
 
 /**
@@ -99,6 +155,70 @@ Result RequestHeaders::addUpgrade(HeaderHash_t header) {
   return ResultCode_t::SUCCESS;
 }
 
+/**
+ * @brief Add accept encoding header
+ * Codings with a quality of zero are not accepted, unknown codings are ignored
+ *
+ * @param header to add
+ */
+void RequestHeaders::addAcceptEncoding(HeaderHash_t header) {
+  const std::string & value = header.value.getString();
+  size_t              begin = 0;
+  while (begin < value.size()) {
+    size_t end = value.find(',', begin);
+    if (end == std::string::npos)
+      end = value.size();
+    size_t nameBegin = value.find_first_not_of(' ', begin);
+    size_t nameEnd   = value.find_first_of(" ;", nameBegin);
+    if (nameEnd == std::string::npos || nameEnd > end)
+      nameEnd = end;
+
+    // "q=0", "q=0.0" or "q=0.000" refuse the coding
+    bool   refused = false;
+    size_t q       = value.find("q=", nameEnd);
+    if (q < end) {
+      size_t qEnd = value.find_first_not_of("0.", q + 2);
+      refused     = qEnd == std::string::npos || qEnd >= end ||
+                value[qEnd] == ' ';
+    }
+
+    if (nameBegin < nameEnd && !refused) {
+      Hash name;
+      name.add(value.substr(nameBegin, nameEnd - nameBegin).c_str());
+      switch (name.get()) {
+        case Hash::calculateHash("br"):
+          acceptEncoding |= 1 << static_cast<uint8_t>(Encoding_t::BROTLI);
+          break;
+        case Hash::calculateHash("gzip"):
+          acceptEncoding |= 1 << static_cast<uint8_t>(Encoding_t::GZIP);
+          break;
+        case Hash::calculateHash("*"):
+          acceptEncoding = 0xFF;
+          break;
+        default:
+          break;
+      }
+    }
+    begin = end + 1;
+  }
+}
+
+/**
+ * @brief Add transfer encoding header
+ * Only a body chunked without any other coding is supported
+ *
+ * @param header to add
+ */
+void RequestHeaders::addTransferEncoding(HeaderHash_t header) {
+  std::string value = header.value.getString();
+  std::transform(value.begin(), value.end(), value.begin(),
+      [](char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+  if (value == "chunked" && transferEncoding == TransferEncoding_t::NOT_SET)
+    transferEncoding = TransferEncoding_t::CHUNKED;
+  else
+    transferEncoding = TransferEncoding_t::NOT_SUPPORTED;
+}
+
 /**
  * @brief Get the content length header value, 0 if not set
  *
@@ -109,7 +229,16 @@ const size_t RequestHeaders::getContentLength() const {
 }
 
 /**
- * @brief Get the connection header, CLOSE if not set
+ * @brief Get the content type header value, empty if not set
+ *
+ * @return const std::string&
+ */
+const std::string & RequestHeaders::getContentType() const {
+  return contentType;
+}
+
+/**
+ * @brief Get the connection header, NOT_SET if not set
  *
  * @return const RequestHeaders::Connection_t
  */
@@ -126,6 +255,158 @@ const RequestHeaders::Upgrade_t RequestHeaders::getUpgrade() const {
   return upgrade;
 }
 
+/**
+ * @brief Get the transfer coding of the body, NOT_SET if not set
+ * A chunked body's length is ignored
+ *
+ * @return const RequestHeaders::TransferEncoding_t
+ */
+const RequestHeaders::TransferEncoding_t
+RequestHeaders::getTransferEncoding() const {
+  return transferEncoding;
+}
+
+/**
+ * @brief Check if the client accepts a content coding
+ *
+ * @param encoding to check
+ * @return true if listed in Accept-Encoding, or identity
+ * @return false otherwise
+ */
+bool RequestHeaders::acceptsEncoding(Encoding_t encoding) const {
+  return (acceptEncoding & (1 << static_cast<uint8_t>(encoding))) != 0;
+}
+
+/**
+ * @brief Check if the client's copy of a representation is current
+ * If-None-Match takes precedence over If-Modified-Since, ETags compare weakly
+ *
+ * @param etag of the representation, with quotes
+ * @param modified time of the representation
+ * @return true if a 304 Not Modified can be sent
+ * @return false if the representation must be sent
+ */
+bool RequestHeaders::isNotModified(
+    const std::string & etag, time_t modified) const {
+  if (!ifNoneMatch.empty()) {
+    size_t begin = 0;
+    while (begin < ifNoneMatch.size()) {
+      size_t end = ifNoneMatch.find(',', begin);
+      if (end == std::string::npos)
+        end = ifNoneMatch.size();
+      size_t first = ifNoneMatch.find_first_not_of(' ', begin);
+      size_t last  = ifNoneMatch.find_last_not_of(' ', end - 1);
+      if (first < end && ifNoneMatch.compare(first, 2, "W/") == 0)
+        first += 2;
+      if (first < end && last != std::string::npos && last >= first) {
+        std::string tag = ifNoneMatch.substr(first, last + 1 - first);
+        if (tag == "*" || tag == etag)
+          return true;
+      }
+      begin = end + 1;
+    }
+    return false;
+  }
+  return ifModifiedSince != 0 && modified <= ifModifiedSince;
+}
+
+/**
+ * @brief Check if the request has a Range header
+ *
+ * @return true if a range is requested
+ * @return false otherwise
+ */
+bool RequestHeaders::hasRange() const {
+  return !range.empty();
+}
+
+/**
+ * @brief Check if the If-Range condition allows serving the ranges
+ * The ETag compares strongly, a date must match the modification exactly
+ *
+ * @param etag of the representation, with quotes
+ * @param modified time of the representation
+ * @return true if there is no If-Range or it matches
+ * @return false if the whole representation must be sent
+ */
+bool RequestHeaders::isRangeCurrent(
+    const std::string & etag, time_t modified) const {
+  if (ifRange.empty())
+    return true;
+  if (ifRange[0] == '"')
+    return ifRange == etag;
+  return parseDate(ifRange) == modified;
+}
+
+/**
+ * @brief Resolve the requested byte ranges against a representation
+ * i.e. "bytes=0-499, 1000-, -200"
+ *
+ * Returns ResultCode_t::NO_OPERATION if the header is malformed, in another
+ * unit, or requests too many ranges, the whole representation is sent
+ * Returns ResultCode_t::INVALID_DATA if no range is satisfiable
+ *
+ * @param size of the representation
+ * @param ranges to return, clipped to the size
+ * @return Result error code
+ */
+Result RequestHeaders::getRanges(
+    size_t size, std::vector<ByteRange_t> & ranges) const {
+  const std::string UNIT = "bytes=";
+  if (range.compare(0, UNIT.size(), UNIT) != 0)
+    return ResultCode_t::NO_OPERATION + ("Range unit: " + range);
+
+  ranges.clear();
+  size_t count = 0;
+  size_t begin = UNIT.size();
+  while (begin < range.size()) {
+    size_t end = range.find(',', begin);
+    if (end == std::string::npos)
+      end = range.size();
+    std::string spec = range.substr(begin, end - begin);
+    begin            = end + 1;
+    spec.erase(0, spec.find_first_not_of(' '));
+    spec.erase(spec.find_last_not_of(' ') + 1);
+    // Positions of at most 18 digits cannot overflow
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos || dash > 18 || spec.size() - dash > 19 ||
+        spec.find_first_not_of("0123456789-") != std::string::npos ||
+        spec.find('-', dash + 1) != std::string::npos ||
+        ++count > RANGES_MAX)
+      return ResultCode_t::NO_OPERATION + ("Range: " + range);
+
+    std::string firstString = spec.substr(0, dash);
+    std::string lastString  = spec.substr(dash + 1);
+    ByteRange_t byteRange;
+    if (firstString.empty()) {
+      // Suffix range, the last n bytes
+      if (lastString.empty())
+        return ResultCode_t::NO_OPERATION + ("Range: " + range);
+      size_t length = static_cast<size_t>(std::stoull(lastString));
+      if (length == 0 || size == 0)
+        continue;
+      byteRange.first = size - std::min(length, size);
+      byteRange.last  = size - 1;
+    } else {
+      byteRange.first = static_cast<size_t>(std::stoull(firstString));
+      byteRange.last  = size - 1;
+      if (!lastString.empty()) {
+        size_t last = static_cast<size_t>(std::stoull(lastString));
+        if (last < byteRange.first)
+          return ResultCode_t::NO_OPERATION + ("Range: " + range);
+        byteRange.last = std::min(byteRange.last, last);
+      }
+      if (byteRange.first >= size)
+        continue;
+    }
+    ranges.push_back(byteRange);
+  }
+
+  if (ranges.empty())
+    return ResultCode_t::INVALID_DATA + ("Range not satisfiable: " + range);
+  return ResultCode_t::SUCCESS;
+}
+
 /**
  * @brief Get the web socket key
  *
@@ -6,6 +6,8 @@
 
 #include <stdint.h>
 #include <string>
+#include <time.h>
+#include <vector>
 
 namespace Ehbanana {
 namespace Web {
@@ -16,29 +18,68 @@ struct HeaderHash_t {
   Hash value;
 };
 
+// Inclusive byte positions of a range
+struct ByteRange_t {
+  size_t first;
+  size_t last;
+};
+
 class RequestHeaders {
 public:
   RequestHeaders();
 
   Result addHeader(HeaderHash_t header);
 
-  enum class Connection_t : uint8_t { CLOSE, KEEP_ALIVE, UPGRADE };
+  enum class Connection_t : uint8_t { NOT_SET, CLOSE, KEEP_ALIVE, UPGRADE };
   enum class Upgrade_t : uint8_t { NOT_SET, WEB_SOCKET };
+  enum class Encoding_t : uint8_t { BROTLI, GZIP, IDENTITY };
+  enum class TransferEncoding_t : uint8_t { NOT_SET, CHUNKED, NOT_SUPPORTED };
+
+  const size_t        getContentLength() const;
+  const std::string & getContentType() const;
+  const Connection_t  getConnection() const;
+  const Upgrade_t     getUpgrade() const;
 
-  const size_t       getContentLength() const;
-  const Connection_t getConnection() const;
-  const Upgrade_t    getUpgrade() const;
+  const TransferEncoding_t getTransferEncoding() const;
+
+  bool acceptsEncoding(Encoding_t encoding) const;
+  bool isNotModified(const std::string & etag, time_t modified) const;
+
+  bool   hasRange() const;
+  bool   isRangeCurrent(const std::string & etag, time_t modified) const;
+  Result getRanges(size_t size, std::vector<ByteRange_t> & ranges) const;
 
   const Hash getWebSocketKey() const;
   const Hash getWebSocketVersion() const;
 
 private:
-  Result addConnection(HeaderHash_t header);
+  Result addContentLength(HeaderHash_t header);
+  void   addConnection(HeaderHash_t header);
   Result addUpgrade(HeaderHash_t header);
+  void   addAcceptEncoding(HeaderHash_t header);
+  void   addTransferEncoding(HeaderHash_t header);
+
+  size_t       contentLength    = 0;
+  bool         contentLengthSet = false;
+  Connection_t connection       = Connection_t::NOT_SET;
+  Upgrade_t    upgrade          = Upgrade_t::NOT_SET;
+
+  TransferEncoding_t transferEncoding = TransferEncoding_t::NOT_SET;
+
+  std::string contentType;
+
+  // Validators of a conditional request
+  std::string ifNoneMatch;
+  time_t      ifModifiedSince = 0;
+  std::string ifRange;
+
+  std::string range;
+
+  // More ranges are served whole, they cost more than they save
+  static const size_t RANGES_MAX = 16;
 
-  size_t       contentLength = 0;
-  Connection_t connection    = Connection_t::CLOSE;
-  Upgrade_t    upgrade       = Upgrade_t::NOT_SET;
+  // Bit per Encoding_t, identity is always acceptable
+  uint8_t acceptEncoding = 1 << static_cast<uint8_t>(Encoding_t::IDENTITY);
 
   Hash webSocketKey;
   Hash webSocketVersion;
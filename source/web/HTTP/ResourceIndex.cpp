@@ -0,0 +1,390 @@
+#include "ResourceIndex.h"
+
+#include "CacheControl.h"
+#include "Date.h"
+#include "EhbananaLog.h"
+#include "MIMETypes.h"
+
+#include <errno.h>
+#include <filesystem>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+const std::chrono::seconds ResourceIndex::RESCAN_INTERVAL(2);
+
+/**
+ * @brief Construct a new Resource Index object
+ *
+ * @param cacheControl rules of each resource's Cache-Control
+ * @param mimeTypes of each resource's Content-Type
+ */
+ResourceIndex::ResourceIndex(
+    CacheControl & cacheControl, MIMETypes & mimeTypes) :
+  cacheControl(cacheControl), mimeTypes(mimeTypes) {}
+
+/**
+ * @brief Index every file of the http root
+ * The index is authoritative, requests never touch the filesystem. On Linux
+ * the root is watched with inotify and the index kept current, elsewhere the
+ * root is indexed again every RESCAN_INTERVAL
+ *
+ * @param httpRoot directory to index
+ * @return Result error code
+ */
+Result ResourceIndex::build(const std::string & httpRoot) {
+  stop();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::error_code             errorCode;
+  if (!std::filesystem::is_directory(httpRoot, errorCode))
+    return ResultCode_t::OPEN_FAILED + ("Indexing http root: " + httpRoot);
+  root       = httpRoot;
+  generation = cacheControl.getGeneration();
+  stopping   = false;
+
+#ifdef __linux__
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd != -1 && pipe2(stopPipe, O_CLOEXEC) != 0) {
+    ::close(fd);
+    fd = -1;
+  }
+  if (fd == -1)
+    warn("Could not watch http root, it is indexed again every " +
+         std::to_string(RESCAN_INTERVAL.count()) + "s instead");
+  watching = fd != -1;
+#endif
+
+  Resources_t                     next;
+  std::unordered_set<std::string> visited;
+  walk("", next, visited);
+  info("Indexed " + std::to_string(next.size()) + " files from \"" + root +
+       "\"");
+  std::atomic_store(
+      &resources, std::make_shared<const Resources_t>(std::move(next)));
+
+#ifdef __linux__
+  if (watching) {
+    thread = std::thread(&ResourceIndex::run, this);
+    return ResultCode_t::SUCCESS;
+  }
+#endif
+  thread = std::thread(&ResourceIndex::rescan, this);
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Stop watching or rescanning the http root, the index is kept as is
+ * Returns once the thread has exited, its descriptors are closed after
+ *
+ */
+void ResourceIndex::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+#ifdef __linux__
+  if (stopPipe[1] != -1)
+    ::close(stopPipe[1]);
+  stopPipe[1] = -1;
+#endif
+  if (thread.joinable())
+    thread.join();
+  watching = false;
+#ifdef __linux__
+  if (fd != -1)
+    ::close(fd);
+  if (stopPipe[0] != -1)
+    ::close(stopPipe[0]);
+  fd          = -1;
+  stopPipe[0] = -1;
+  directories.clear();
+#endif
+}
+
+/**
+ * @brief Find the resource of a URI
+ *
+ * @param uri absolute, without queries
+ * @return ResourcePtr_t resource, nullptr if there is no such file
+ */
+ResourcePtr_t ResourceIndex::find(const std::string & uri) {
+  if (cacheControl.getGeneration() != generation)
+    refreshCacheControl();
+  std::shared_ptr<const Resources_t> current = std::atomic_load(&resources);
+  auto                               i       = current->find(uri);
+  return i == current->end() ? nullptr : i->second;
+}
+
+/**
+ * @brief Format a strong ETag from the modification time and size, with its
+ * quotes
+ *
+ * @param modified time of the file
+ * @param size of the representation
+ * @param suffix of the representation's encoding, i.e. "-gz"
+ * @return std::string ETag
+ */
+std::string ResourceIndex::formatETag(
+    time_t modified, size_t size, const char * suffix) {
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%llx-%llx%s\"",
+      static_cast<unsigned long long>(modified),
+      static_cast<unsigned long long>(size), suffix);
+  return etag;
+}
+
+/**
+ * @brief Add the files of a directory and its subdirectories
+ * A directory reached again through a link is skipped
+ *
+ * @param uri of the directory, empty for the root
+ * @param resources to add to
+ * @param visited canonical paths of the directories walked
+ */
+void ResourceIndex::walk(const std::string & uri, Resources_t & resources,
+    std::unordered_set<std::string> & visited) {
+  std::error_code errorCode;
+  std::string     path =
+      std::filesystem::canonical(root + uri, errorCode).generic_string();
+  if (errorCode || !visited.insert(path).second)
+    return;
+#ifdef __linux__
+  // Watched before listing so no file is missed
+  if (watching)
+    watch(uri);
+#endif
+
+  std::filesystem::directory_iterator i(root + uri, errorCode);
+  std::filesystem::directory_iterator end;
+  for (; !errorCode && i != end; i.increment(errorCode)) {
+    std::string     child = uri + "/" + i->path().filename().generic_string();
+    std::error_code statusCode;
+    if (i->is_directory(statusCode))
+      walk(child, resources, visited);
+    else {
+      ResourcePtr_t resource = load(child);
+      if (resource != nullptr)
+        resources[child] = resource;
+    }
+  }
+}
+
+/**
+ * @brief Load the metadata of a file and format its entity headers
+ *
+ * @param uri of the file
+ * @return ResourcePtr_t resource, nullptr if it is not a regular file
+ */
+ResourcePtr_t ResourceIndex::load(const std::string & uri) {
+  std::string path = root + uri;
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0 ||
+      (status.st_mode & S_IFMT) != S_IFREG)
+    return nullptr;
+
+  std::shared_ptr<Resource_t> resource = std::make_shared<Resource_t>();
+  resource->uri          = uri;
+  resource->path         = path;
+  resource->size         = static_cast<size_t>(status.st_size);
+  resource->modified     = status.st_mtime;
+  resource->type         = mimeTypes.getType(uri, true);
+  resource->cacheControl = cacheControl.getCacheControl(uri);
+  resource->etag         = formatETag(resource->modified, resource->size);
+  resource->lastModified = formatDate(resource->modified);
+  return resource;
+}
+
+/**
+ * @brief Keep the current resource of each file that did not change
+ * Assets cached from them stay valid across a new index
+ *
+ * @param next index to update, the mutex must be held
+ */
+void ResourceIndex::keepUnchanged(Resources_t & next) const {
+  for (std::pair<const std::string, ResourcePtr_t> & pair : next) {
+    auto i = resources->find(pair.first);
+    if (i != resources->end() && i->second->modified == pair.second->modified &&
+        i->second->size == pair.second->size &&
+        i->second->cacheControl == pair.second->cacheControl)
+      pair.second = i->second;
+  }
+}
+
+/**
+ * @brief Update the Cache-Control of every resource once the rules reload
+ *
+ */
+void ResourceIndex::refreshCacheControl() {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint32_t current = cacheControl.getGeneration();
+  if (current == generation)
+    return;
+  generation = current;
+
+  Resources_t next = *resources;
+  for (std::pair<const std::string, ResourcePtr_t> & pair : next) {
+    std::shared_ptr<Resource_t> resource =
+        std::make_shared<Resource_t>(*pair.second);
+    resource->cacheControl =
+        cacheControl.getCacheControl(pair.first);
+    pair.second = resource;
+  }
+  std::atomic_store(
+      &resources, std::make_shared<const Resources_t>(std::move(next)));
+}
+
+/**
+ * @brief Index the root again every RESCAN_INTERVAL until stopped
+ * Files added, modified and removed since are found within the interval
+ *
+ */
+void ResourceIndex::rescan() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!wake.wait_for(lock, RESCAN_INTERVAL, [this]() { return stopping; })) {
+    lock.unlock();
+    Resources_t                     next;
+    std::unordered_set<std::string> visited;
+    walk("", next, visited);
+    lock.lock();
+    keepUnchanged(next);
+    std::atomic_store(
+        &resources, std::make_shared<const Resources_t>(std::move(next)));
+  }
+}
+
+#ifdef __linux__
+/**
+ * @brief Apply the changes of the watched directories to the index until
+ * stopped
+ * Each batch of events is applied to a copy that is swapped in whole
+ *
+ */
+void ResourceIndex::run() {
+  alignas(struct inotify_event) char buffer[16384];
+  struct pollfd descriptors[2] = {{fd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+  for (;;) {
+    if (poll(descriptors, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      warn("Polling http root watch: " + std::to_string(errno) +
+           ", rescanning instead");
+      watching = false;
+      rescan();
+      return;
+    }
+    if (descriptors[1].revents != 0)
+      return;
+    ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length <= 0)
+      continue;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Resources_t                 next     = *resources;
+    bool                        overflow = false;
+    for (char * i = buffer; i < buffer + length;) {
+      const struct inotify_event * event =
+          reinterpret_cast<const struct inotify_event *>(i);
+      i += sizeof(struct inotify_event) + event->len;
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        overflow = true;
+        continue;
+      }
+      if ((event->mask & IN_IGNORED) != 0) {
+        directories.erase(event->wd);
+        continue;
+      }
+      auto directory = directories.find(event->wd);
+      if (directory == directories.end() || event->len == 0)
+        continue;
+      update(directory->second + "/" + event->name,
+          (event->mask & IN_ISDIR) != 0,
+          (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0, next);
+    }
+    if (overflow) {
+      // Events were lost, index the root again
+      warn("Http root watch overflowed, indexing again");
+      for (const std::pair<const int, std::string> & directory : directories)
+        inotify_rm_watch(fd, directory.first);
+      directories.clear();
+      next.clear();
+      std::unordered_set<std::string> visited;
+      walk("", next, visited);
+      keepUnchanged(next);
+    }
+    std::atomic_store(
+        &resources, std::make_shared<const Resources_t>(std::move(next)));
+  }
+}
+
+/**
+ * @brief Watch a directory for files written, added, removed and touched
+ *
+ * @param uri of the directory, empty for the root
+ */
+void ResourceIndex::watch(const std::string & uri) {
+  int wd = inotify_add_watch(fd, (root + uri).c_str(),
+      IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+          IN_ATTRIB | IN_ONLYDIR);
+  if (wd == -1) {
+    warn("Could not watch \"" + root + uri + "\"");
+    return;
+  }
+  directories[wd] = uri;
+}
+
+/**
+ * @brief Update the index for a changed entry of a watched directory
+ *
+ * @param uri of the entry
+ * @param directory true if the entry is a directory
+ * @param removed true if the entry was deleted or moved away
+ * @param resources to update
+ */
+void ResourceIndex::update(const std::string & uri, bool directory,
+    bool removed, Resources_t & resources) {
+  if (!directory) {
+    ResourcePtr_t resource = removed ? nullptr : load(uri);
+    if (resource != nullptr)
+      resources[uri] = resource;
+    else
+      resources.erase(uri);
+    return;
+  }
+  if (!removed) {
+    std::unordered_set<std::string> visited;
+    walk(uri, resources, visited);
+    return;
+  }
+
+  // A directory moved away keeps its watches, remove them with its files
+  const std::string prefix = uri + "/";
+  for (auto i = directories.begin(); i != directories.end();) {
+    if (i->second == uri || i->second.compare(0, prefix.size(), prefix) == 0) {
+      inotify_rm_watch(fd, i->first);
+      i = directories.erase(i);
+    } else
+      ++i;
+  }
+  for (auto i = resources.begin(); i != resources.end();) {
+    if (i->first.compare(0, prefix.size(), prefix) == 0)
+      i = resources.erase(i);
+    else
+      ++i;
+  }
+}
+#endif
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
@@ -0,0 +1,112 @@
+#ifndef _WEB_RESOURCE_INDEX_H_
+#define _WEB_RESOURCE_INDEX_H_
+
+#include "CacheControl.h"
+#include "MIMETypes.h"
+
+#include <FruitBowl.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+// A file of the http root, its metadata is known without touching it
+struct Resource_t {
+  std::string uri;
+  std::string path;
+  size_t      size     = 0;
+  time_t      modified = 0;
+
+  // Entity headers of the identity representation
+  std::string type;
+  std::string cacheControl;
+  std::string etag;
+  std::string lastModified;
+};
+
+typedef std::shared_ptr<const Resource_t> ResourcePtr_t;
+
+class ResourceIndex {
+public:
+  ResourceIndex(const ResourceIndex &) = delete;
+  ResourceIndex & operator=(const ResourceIndex &) = delete;
+
+  ResourceIndex(CacheControl & cacheControl, MIMETypes & mimeTypes);
+
+  Result build(const std::string & httpRoot);
+  void   stop();
+
+  ResourcePtr_t find(const std::string & uri);
+
+  static std::string formatETag(
+      time_t modified, size_t size, const char * suffix = "");
+
+private:
+  typedef std::unordered_map<std::string, ResourcePtr_t> Resources_t;
+
+  void          walk(const std::string & uri, Resources_t & resources,
+      std::unordered_set<std::string> & visited);
+  ResourcePtr_t load(const std::string & uri);
+  void          keepUnchanged(Resources_t & next) const;
+  void          refreshCacheControl();
+  void          rescan();
+
+#ifdef __linux__
+  void run();
+  void watch(const std::string & uri);
+  void update(const std::string & uri, bool directory, bool removed,
+      Resources_t & resources);
+#endif
+
+  // Rules of the server the entity headers are formatted with
+  CacheControl & cacheControl;
+  MIMETypes &    mimeTypes;
+
+  std::string root;
+
+  // Workers read the resources without locking, updates swap them in
+  std::mutex                         mutex;
+  std::shared_ptr<const Resources_t> resources =
+      std::make_shared<const Resources_t>();
+
+  // Of the cache control rules the resources were made with
+  std::atomic<uint32_t> generation{0};
+
+  // Without a watcher, the root is indexed again every RESCAN_INTERVAL
+  static const std::chrono::seconds RESCAN_INTERVAL;
+
+  std::atomic<bool> watching{false};
+
+  // Watches or rescans the root until stopped
+  std::thread             thread;
+  std::condition_variable wake;
+  bool                    stopping = false;
+
+#ifdef __linux__
+  int fd = -1;
+
+  // Closing the write end wakes the watcher
+  int stopPipe[2] = {-1, -1};
+
+  // URI of the directory of each watch descriptor
+  std::unordered_map<int, std::string> directories;
+#endif
+};
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_RESOURCE_INDEX_H_ */
@@ -0,0 +1,113 @@
+#include "Router.h"
+
+#include <algorithm>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+/**
+ * @brief Route requests of a method whose URI starts with a prefix
+ * The longest matching prefix is routed, an exact route of the whole URI is
+ * preferred. Replaces the processes already registered to the same route
+ *
+ * @param method of the requests, i.e. "GET"
+ * @param prefix of the URIs, absolute
+ * @param route processes to receive the bodies and produce the responses
+ * @param exact true only routes the prefix itself
+ * @return Result error code
+ */
+Result Router::addRoute(const std::string & method, const std::string & prefix,
+    const Route_t & route, bool exact) {
+  if (method != "GET" && method != "POST" && method != "PUT" &&
+      method != "DELETE")
+    return ResultCode_t::NOT_SUPPORTED + ("Route method: " + method);
+  if (prefix.empty() || prefix[0] != '/')
+    return ResultCode_t::INVALID_DATA + ("Route is not absolute: " + prefix);
+  if (route.process == nullptr)
+    return ResultCode_t::INVALID_DATA + ("Route process is nullptr: " + prefix);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<Routes_t>   next = std::make_shared<Routes_t>(*routes);
+  Trie_t &                    trie = (*next)[method];
+  if (trie.empty())
+    trie.emplace_back();
+
+  uint32_t index = 0;
+  for (char c : prefix) {
+    std::vector<std::pair<char, uint32_t>> & children = trie[index].children;
+    auto child = std::lower_bound(children.begin(), children.end(), c,
+        [](const std::pair<char, uint32_t> & pair, char value) {
+          return pair.first < value;
+        });
+    if (child != children.end() && child->first == c) {
+      index = child->second;
+      continue;
+    }
+    // Insert before growing the trie, which moves the children
+    uint32_t childIndex = static_cast<uint32_t>(trie.size());
+    children.insert(child, {c, childIndex});
+    trie.emplace_back();
+    index = childIndex;
+  }
+  if (exact)
+    trie[index].exact = route;
+  else
+    trie[index].prefix = route;
+
+  std::atomic_store(&routes, std::shared_ptr<const Routes_t>(next));
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get the process routed for a request
+ * Walks the URI once through the method's trie
+ *
+ * @param method of the request
+ * @param uri of the request, without queries
+ * @return Route_t route, its process is nullptr if none is routed
+ */
+Route_t Router::getRoute(
+    const std::string & method, const std::string & uri) const {
+  std::shared_ptr<const Routes_t> current = std::atomic_load(&routes);
+  auto                            i       = current->find(method);
+  if (i == current->end())
+    return Route_t();
+
+  const Trie_t & trie  = i->second;
+  const Node_t * node  = &trie.front();
+  Route_t        route = node->prefix;
+  for (char c : uri) {
+    node = findChild(trie, *node, c);
+    if (node == nullptr)
+      return route;
+    if (node->prefix.process != nullptr)
+      route = node->prefix;
+  }
+  if (node->exact.process != nullptr)
+    return node->exact;
+  return route;
+}
+
+/**
+ * @brief Find the child of a node by its character
+ *
+ * @param trie of the node
+ * @param node to search
+ * @param c character of the child
+ * @return const Node_t * child, nullptr if not found
+ */
+const Router::Node_t * Router::findChild(
+    const Trie_t & trie, const Node_t & node, char c) {
+  auto child = std::lower_bound(node.children.begin(), node.children.end(), c,
+      [](const std::pair<char, uint32_t> & pair, char value) {
+        return pair.first < value;
+      });
+  if (child == node.children.end() || child->first != c)
+    return nullptr;
+  return &trie[child->second];
+}
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
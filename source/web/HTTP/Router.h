@@ -0,0 +1,69 @@
+#ifndef _WEB_ROUTER_H_
+#define _WEB_ROUTER_H_
+
+#include "Ehbanana.h"
+
+#include <FruitBowl.h>
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Ehbanana {
+namespace Web {
+namespace HTTP {
+
+// Processes of a route, the body process receives the request body as it
+// arrives instead of it being buffered
+struct Route_t {
+  EBStreamProcess_t process = nullptr;
+  EBBodyProcess_t   body    = nullptr;
+};
+
+// Routes of one server, each GUI serves its own
+class Router {
+public:
+  Router(const Router &) = delete;
+  Router & operator=(const Router &) = delete;
+
+  /**
+   * @brief Construct a new Router object
+   *
+   */
+  Router() {}
+
+  Result addRoute(const std::string & method, const std::string & prefix,
+      const Route_t & route, bool exact = false);
+
+  Route_t getRoute(const std::string & method, const std::string & uri) const;
+
+private:
+  struct Node_t {
+    // Sorted by character, the index of each child node
+    std::vector<std::pair<char, uint32_t>> children;
+
+    Route_t prefix;
+    Route_t exact;
+  };
+
+  // The root is the first node
+  typedef std::vector<Node_t>                     Trie_t;
+  typedef std::unordered_map<std::string, Trie_t> Routes_t;
+
+  static const Node_t * findChild(
+      const Trie_t & trie, const Node_t & node, char c);
+
+  // Registrations copy the routes and swap them in, lookups never lock
+  std::mutex                      mutex;
+  std::shared_ptr<const Routes_t> routes = std::make_shared<const Routes_t>();
+};
+
+} // namespace HTTP
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_ROUTER_H_ */
@@ -0,0 +1,224 @@
+#include "Stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Construct a new EBStream object
+ * Made once the request's headers are parsed, before its body. The URI and
+ * queries are copied, the request is reused once its reply is queued
+ *
+ * @param route processes to receive the body and produce the response
+ * @param request to respond to
+ */
+EBStream::EBStream(const Ehbanana::Web::HTTP::Route_t & route,
+    const Ehbanana::Web::HTTP::Request & request) :
+  process(route.process),
+  bodyProcess(route.body), uri(request.getURI().getString()),
+  framed(request.getHTTPVersion().get() == Hash::calculateHash("HTTP/1.1")) {
+  for (const Ehbanana::Web::HTTP::HeaderHash_t & query : request.getQueries())
+    queries.emplace_back(query.name.getString(), query.value.getString());
+}
+
+/**
+ * @brief Prepare to receive the body of the request
+ *
+ * @param headers of the request
+ */
+void EBStream::openBody(const Ehbanana::Web::HTTP::RequestHeaders & headers) {
+  if (bodyProcess == nullptr)
+    bodyResult = body.open(headers);
+}
+
+/**
+ * @brief Receive a fragment of the body of the request
+ * Passed to the body process, else written to the body
+ *
+ * @param begin of the fragment
+ * @param length of the fragment
+ */
+void EBStream::receive(const uint8_t * begin, size_t length) {
+  if (!bodyResult)
+    return;
+  if (bodyProcess == nullptr) {
+    bodyResult = body.write(begin, length);
+    return;
+  }
+  ResultCode_t resultCode = bodyProcess(this, begin, length);
+  if (resultCode != ResultCode_t::SUCCESS)
+    bodyResult = resultCode + ("Body process: " + uri);
+}
+
+/**
+ * @brief Finish receiving the body of the request
+ *
+ */
+void EBStream::closeBody() {
+  if (bodyResult && bodyProcess == nullptr)
+    bodyResult = body.close();
+}
+
+/**
+ * @brief Call the process for the next chunk
+ * The terminating chunk is appended once the process finishes. If it
+ * finishes in its first call, the chunk is the whole body, unframed. Chunks
+ * of an HTTP/1.0 request are never framed
+ *
+ * Returns ResultCode_t::INVALID_STATE if the process neither wrote nor
+ * finished, and the error receiving the body before the first call
+ *
+ * @return Result error code
+ */
+Result EBStream::produce() {
+  if (!bodyResult)
+    return bodyResult + "Receiving request body";
+  // The size line is filled in once the data is written
+  chunk.assign(SIZE_LINE_LENGTH, '0');
+  producing               = true;
+  ResultCode_t resultCode = process(this);
+  producing               = false;
+  bool         first      = !started;
+  started                 = true;
+
+  size_t length = chunk.size() - SIZE_LINE_LENGTH;
+  if (resultCode == ResultCode_t::SUCCESS)
+    finished = true;
+  else if (resultCode != ResultCode_t::INCOMPLETE)
+    return resultCode + ("Stream process: " + uri);
+  else if (length == 0)
+    return ResultCode_t::INVALID_STATE + ("Stream wrote nothing: " + uri);
+
+  if (first && finished) {
+    // Sent with its length, it may be compressed
+    chunk.erase(0, SIZE_LINE_LENGTH);
+    return ResultCode_t::SUCCESS;
+  }
+  chunked = true;
+  if (!framed) {
+    chunk.erase(0, SIZE_LINE_LENGTH);
+    return ResultCode_t::SUCCESS;
+  }
+  if (length == 0)
+    chunk.clear();
+  else {
+    char sizeLine[SIZE_LINE_LENGTH + 1];
+    snprintf(sizeLine, sizeof(sizeLine), "%016llx\r\n",
+        static_cast<unsigned long long>(length));
+    memcpy(&chunk[0], sizeLine, SIZE_LINE_LENGTH);
+    chunk += "\r\n";
+  }
+  if (finished)
+    chunk += "0\r\n\r\n";
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Append bytes to the current chunk
+ *
+ * @param data to write
+ * @param length of data
+ * @return Result error code
+ */
+Result EBStream::write(const void * data, size_t length) {
+  if (!producing)
+    return ResultCode_t::INVALID_STATE + "Stream written outside its process";
+  chunk.append(static_cast<const char *>(data), length);
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Add a header to the response, before the first chunk is sent
+ *
+ * @param name of the header
+ * @param value of the header
+ * @return Result error code
+ */
+Result EBStream::addHeader(
+    const std::string & name, const std::string & value) {
+  if (!producing || started)
+    return ResultCode_t::INVALID_STATE + ("Stream header after start: " + name);
+  headers.emplace_back(name, value);
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get the value of a query of the request
+ *
+ * @param name of the query
+ * @return const char * value, nullptr if not present
+ */
+const char * EBStream::getQuery(const std::string & name) const {
+  for (const std::pair<std::string, std::string> & query : queries) {
+    if (query.first == name)
+      return query.second.c_str();
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Get the URI of the request
+ *
+ * @return const std::string & uri
+ */
+const std::string & EBStream::getURI() const {
+  return uri;
+}
+
+/**
+ * @brief Get the body of the request
+ *
+ * @return const Ehbanana::Web::HTTP::Body & body, empty if received by the
+ * body process
+ */
+const Ehbanana::Web::HTTP::Body & EBStream::getBody() const {
+  return body;
+}
+
+/**
+ * @brief Get the headers added by the process
+ *
+ * @return const std::vector<std::pair<std::string, std::string>> & headers
+ */
+const std::vector<std::pair<std::string, std::string>> &
+EBStream::getHeaders() const {
+  return headers;
+}
+
+/**
+ * @brief Get the current chunk, framed and ready to send
+ *
+ * @return const std::string & chunk
+ */
+const std::string & EBStream::getChunk() const {
+  return chunk;
+}
+
+/**
+ * @brief Check if the response is sent with chunked transfer encoding
+ *
+ * @return true if the process did not finish in its first call
+ * @return false otherwise
+ */
+bool EBStream::isChunked() const {
+  return chunked;
+}
+
+/**
+ * @brief Check if the chunks are framed for chunked transfer encoding
+ *
+ * @return true if the request is HTTP/1.1
+ * @return false if the response ends when the connection closes
+ */
+bool EBStream::isFramed() const {
+  return framed;
+}
+
+/**
+ * @brief Check if the process has finished the response
+ *
+ * @return true if the terminating chunk has been produced
+ * @return false otherwise
+ */
+bool EBStream::isFinished() const {
+  return finished;
+}
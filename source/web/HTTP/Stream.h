@@ -0,0 +1,80 @@
+#ifndef _WEB_STREAM_H_
+#define _WEB_STREAM_H_
+
+#include "Body.h"
+#include "Ehbanana.h"
+#include "Request.h"
+#include "Router.h"
+
+#include <FruitBowl.h>
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Response produced by an application's process, one chunk at a time
+ * Each chunk is framed for chunked transfer encoding as it is written, a
+ * response produced in one call is left whole. HTTP/1.0 has no chunked
+ * encoding, its chunks are sent raw and the connection closes to end them
+ *
+ */
+struct EBStream {
+public:
+  EBStream(const EBStream &) = delete;
+  EBStream & operator=(const EBStream &) = delete;
+
+  EBStream(const Ehbanana::Web::HTTP::Route_t & route,
+      const Ehbanana::Web::HTTP::Request & request);
+
+  void openBody(const Ehbanana::Web::HTTP::RequestHeaders & headers);
+  void receive(const uint8_t * begin, size_t length);
+  void closeBody();
+
+  Result produce();
+  Result write(const void * data, size_t length);
+  Result addHeader(const std::string & name, const std::string & value);
+
+  const char *                      getQuery(const std::string & name) const;
+  const std::string &               getURI() const;
+  const Ehbanana::Web::HTTP::Body & getBody() const;
+
+  const std::vector<std::pair<std::string, std::string>> & getHeaders() const;
+
+  const std::string & getChunk() const;
+  bool                isChunked() const;
+  bool                isFramed() const;
+  bool                isFinished() const;
+
+  uint64_t cursor = 0;
+
+private:
+  // Fixed width chunk size line, leading zeros are allowed
+  static const size_t SIZE_DIGITS      = 16;
+  static const size_t SIZE_LINE_LENGTH = SIZE_DIGITS + 2;
+
+  EBStreamProcess_t process;
+  EBBodyProcess_t   bodyProcess;
+  std::string       uri;
+
+  Ehbanana::Web::HTTP::Body body;
+
+  // The first error receiving the body, the rest of it is discarded
+  Result bodyResult = ResultCode_t::SUCCESS;
+
+  std::vector<std::pair<std::string, std::string>> queries;
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  std::string chunk;
+
+  bool producing = false;
+  bool started   = false;
+  bool chunked   = false;
+  bool finished  = false;
+
+  // Chunks are framed for HTTP/1.1 requests only
+  bool framed = true;
+};
+
+#endif /* _WEB_STREAM_H_ */
@@ -0,0 +1,113 @@
+#ifndef _WEB_MPSC_RING_H_
+#define _WEB_MPSC_RING_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace Ehbanana {
+namespace Web {
+
+/**
+ * @brief Bounded lock-free multi-producer single-consumer ring
+ *
+ * Each cell carries a sequence number: producers claim a position with a
+ * compare and swap then publish the value by advancing the cell's sequence,
+ * the consumer takes values in order without atomic read-modify-writes.
+ * Values are moved in and out, never copied. Producers never block, pushing
+ * to a full ring fails instead.
+ *
+ * @tparam T type of the values, default constructible and movable
+ */
+template <typename T>
+class MPSCRing {
+public:
+  MPSCRing(const MPSCRing &) = delete;
+  MPSCRing & operator=(const MPSCRing &) = delete;
+
+  /**
+   * @brief Construct a new MPSCRing object
+   *
+   * @param capacity number of values, rounded up to a power of 2
+   */
+  MPSCRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    cells = std::vector<Cell_t>(size);
+    mask  = size - 1;
+    for (size_t i = 0; i < size; ++i)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Push a value into the ring, safe to call from any thread
+   *
+   * @param value to move into the ring
+   * @return true if the value was pushed
+   * @return false if the ring is full, value is left untouched
+   */
+  bool push(T && value) {
+    Cell_t * cell;
+    size_t   pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell         = &cells[pos & mask];
+      size_t   seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0)
+        return false;
+      else
+        pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Pop the oldest value from the ring, only call from the consumer
+   * thread
+   *
+   * @param value to move the popped value into
+   * @return true if a value was popped
+   * @return false if the ring is empty
+   */
+  bool pop(T & value) {
+    Cell_t & cell = cells[dequeuePos & mask];
+    size_t   seq  = cell.sequence.load(std::memory_order_acquire);
+    intptr_t diff =
+        static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos + 1);
+    if (diff < 0)
+      return false;
+    value      = std::move(cell.value);
+    cell.value = T();
+    cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+    ++dequeuePos;
+    return true;
+  }
+
+private:
+  struct Cell_t {
+    std::atomic<size_t> sequence;
+    T                   value;
+  };
+
+  std::vector<Cell_t> cells;
+  size_t              mask;
+
+  // Separate cache lines, producers contend on enqueuePos only
+  alignas(64) std::atomic<size_t> enqueuePos {0};
+  alignas(64) size_t dequeuePos = 0;
+};
+
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_MPSC_RING_H_ */
\ No newline at end of file
@@ -1,14 +1,18 @@
 #include "Server.h"
 
 #include "EhbananaLog.h"
-#include "HTTP/CacheControl.h"
-#include "HTTP/MIMETypes.h"
+#include "HTTP/Body.h"
+#include "WebSocket/Frame.h"
 
+#include <algorithm>
+#include <errno.h>
 #include <string>
 
 namespace Ehbanana {
 namespace Web {
 
+const std::chrono::milliseconds Server::ACCEPT_BACKOFF(100);
+
 /**
  * @brief Construct a new Server:: Server object
  *
@@ -17,18 +21,47 @@ namespace Web {
  * in progress (allows time for browser to load new pages)
  * @param timeoutFirst in seconds to wait before exiting when the first
  * connection is in progress (allows time for browser to boot)
+ * @param ioThreads number of workers serving connections, each with its own
+ * thread and io_context, 0 for one per hardware thread
+ * @param idleShutdown true will shutdown after the idle timeouts, false will
+ * run until stopped
  */
-Server::Server(EBGUI_t gui, uint8_t timeoutIdle, uint8_t timeoutFirst) :
-  ioContext(1), acceptor(ioContext), gui(gui),
-  TIMEOUT_NO_CONNECTIONS(timeoutIdle), TIMEOUT_FIRST_CONNECTIONS(timeoutFirst) {
+Server::Server(EBGUI_t gui, uint8_t timeoutIdle, uint8_t timeoutFirst,
+    uint8_t ioThreads, bool idleShutdown) :
+  resourceIndex(cacheControl, mimeTypes), assetCache(resourceIndex, compressor),
+  gui(gui), TIMEOUT_NO_CONNECTIONS(timeoutIdle),
+  TIMEOUT_FIRST_CONNECTIONS(timeoutFirst), IDLE_SHUTDOWN(idleShutdown) {
+  size_t workerCount = ioThreads;
+  if (workerCount == 0)
+    workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+  for (size_t i = 0; i < workerCount; ++i)
+    workers.push_back(new Worker(this, gui));
+
+  acceptor    = new asio::ip::tcp::acceptor(workers.front()->getIOContext());
+  timerIdle   = new TimerWheel::Timer([this]() { onTimeoutIdle(); });
+  timerAccept = new TimerWheel::Timer([this]() { startAccept(); });
 }
 
 /**
  * @brief Destroy the Server:: Server object
- * Safely stop the thread and any open connections
+ * Safely stop the threads and any open connections
  */
 Server::~Server() {
   stop();
+  compressor.stop();
+  resourceIndex.stop();
+  debug("Asset cache hits: " + std::to_string(assetCache.getHits()) +
+        ", misses: " + std::to_string(assetCache.getMisses()));
+  size_t outputDropped = 0;
+  for (Worker * worker : workers)
+    outputDropped += worker->getOutputDropped();
+  debug("Output messages dropped: " + std::to_string(outputDropped));
+  delete acceptor;
+  delete timerIdle;
+  delete timerAccept;
+  for (Worker * worker : workers)
+    delete worker;
+  workers.clear();
 }
 
 /**
@@ -42,15 +75,21 @@ Result Server::configure(
     const std::string & httpRoot, const std::string & configRoot) {
   Result result;
 
-  HTTP::HTTP::setRoot(httpRoot);
-  result =
-      HTTP::CacheControl::Instance()->populateList(configRoot + "/cache.xml");
+  assetCache.setCapacity(gui->settings.assetCacheBytes);
+  assetCache.setLargeFileBytes(gui->settings.largeFileBytes);
+  compressor.configure(gui->settings.compress, gui->settings.compressMinBytes);
+  HTTP::Body::setLimits(
+      gui->settings.bodyMaxBytes, gui->settings.bodyMemoryBytes);
+  result = cacheControl.populateList(configRoot + "/cache.xml");
   if (!result)
     return result + "Configuring server's cache control";
-  result =
-      HTTP::MIMETypes::Instance()->populateList(configRoot + "/mime.types");
+  result = mimeTypes.populateList(configRoot + "/mime.types");
   if (!result)
     return result + "Configuring server's mime types";
+  // Indexed last, each resource's headers use the types and cache control
+  result = resourceIndex.build(httpRoot);
+  if (!result)
+    return result + "Configuring server's http root";
   return ResultCode_t::SUCCESS;
 }
 
@@ -69,8 +108,8 @@ Result Server::initializeSocket(const std::string & addr, uint16_t port) {
   try {
     asio::ip::address address = asio::ip::make_address(addr);
     endpoint                  = asio::ip::tcp::endpoint(address, port);
-    acceptor.open(endpoint.protocol());
-    acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+    acceptor->open(endpoint.protocol());
+    acceptor->set_option(asio::ip::tcp::acceptor::reuse_address(true));
   } catch (const asio::system_error & e) {
     return ResultCode_t::EXCEPTION_OCCURRED + e.what() + "Creating acceptor";
   }
@@ -84,7 +123,7 @@ Result Server::initializeSocket(const std::string & addr, uint16_t port) {
   }
   do {
     endpoint.port(port);
-    acceptor.bind(endpoint, errorCode);
+    acceptor->bind(endpoint, errorCode);
     if (!errorCode)
       attemptComplete = true;
     else if (errorCode.value() != asio::error::address_in_use &&
@@ -98,8 +137,7 @@ Result Server::initializeSocket(const std::string & addr, uint16_t port) {
   } while (!attemptComplete && port < 65535);
 
   try {
-    acceptor.non_blocking(true);
-    acceptor.listen(asio::ip::tcp::socket::max_listen_connections);
+    acceptor->listen(asio::ip::tcp::socket::max_listen_connections);
   } catch (const asio::system_error & e) {
     return ResultCode_t::EXCEPTION_OCCURRED + e.what() +
            "Setting acceptor options";
@@ -112,149 +150,176 @@ Result Server::initializeSocket(const std::string & addr, uint16_t port) {
 }
 
 /**
- * @brief Start the run thread
+ * @brief Start the worker threads
  *
  */
 void Server::start() {
   stop();
-  running = true;
-  thread  = new std::thread(&Server::run, this);
+  for (Worker * worker : workers)
+    worker->start();
+  asio::post(workers.front()->getIOContext(), [this]() {
+    startAccept();
+    startTimeoutIdle();
+  });
 }
 
 /**
- * @brief Execute thread operations
- * Accepts new connections, reads and writes open connections
+ * @brief Wait for the next connection
+ * Accepted connections are handed to the workers in a round robin
  *
  */
-void Server::run() {
-  asio::ip::tcp::socket * socket = nullptr;
-  asio::ip::tcp::endpoint endpoint;
-  asio::error_code        errorCode;
-  Result                  result;
-  bool                    didSomething            = false;
-  bool                    outputMessageDispatched = false;
+void Server::startAccept() {
+  Worker * worker = workers[nextWorker];
+  nextWorker      = (nextWorker + 1) % workers.size();
+  acceptor->async_accept(worker->getIOContext(),
+      [this, worker](
+          const asio::error_code & errorCode, asio::ip::tcp::socket socket) {
+        if (errorCode == asio::error::operation_aborted)
+          return;
+        if (errorCode) {
+          onAcceptError(errorCode);
+          return;
+        }
 
-  auto now         = std::chrono::system_clock::now();
-  auto timeoutTime = std::chrono::time_point<std::chrono::system_clock>::min();
+        asio::error_code        endpointErrorCode;
+        asio::ip::tcp::endpoint endpoint =
+            socket.remote_endpoint(endpointErrorCode);
+        std::string endpointString = endpoint.address().to_string() + ":" +
+                                     std::to_string(endpoint.port());
+        info("Opening connection to " + endpointString);
+        ++connectionCount;
+        firstConnectionMade = true;
+        timerIdle->cancel();
+        worker->addConnection(std::move(socket), endpointString);
 
-  while (running) {
-    didSomething = false;
-    now          = std::chrono::system_clock::now();
-
-    // Check for new connections
-    if (socket == nullptr)
-      socket = new asio::ip::tcp::socket(ioContext);
-    acceptor.accept(*socket, endpoint, errorCode);
-    if (!errorCode) {
-      std::string endpointString = endpoint.address().to_string() + ":" +
-                                   std::to_string(endpoint.port());
-      info("Opening connection to " + endpointString);
-      connections.push_back(new Connection(socket, endpointString, now, gui));
-      socket              = nullptr;
-      didSomething        = true;
-      firstConnectionMade = true;
-    } else if (errorCode != asio::error::would_block) {
-      running      = false;
-      didSomething = true;
-    }
-    // else no waiting connections
-
-    // Process current connections
-    std::list<Connection *>::iterator i   = connections.begin();
-    std::list<Connection *>::iterator end = connections.end();
-    outputMessageDispatched               = false;
-    while (i != end) {
-      Connection * connection = *i;
-
-      // Add the next output message if available
-      if (!outputMessages.empty()) {
-        result = connection->addMessage(outputMessages.front());
-        if (result)
-          outputMessageDispatched = true;
-      }
+        startAccept();
+      });
+}
 
-      // Remove the connection and delete if update returns the connection is
-      // complete
-      result = connection->update(now);
-      if (result == ResultCode_t::INCOMPLETE) {
-        ++i;
-        didSomething = true;
-      } else if (result == ResultCode_t::NO_OPERATION)
-        ++i;
-      else {
-        if (result == ResultCode_t::TIMEOUT)
-          info("Closing connection to " + connection->getEndpoint() +
-               " - Timeout");
-        else if (!result)
-          error("Closing connection to " + connection->getEndpoint() + " - " +
-                result.getMessage());
-        else
-          info("Closing connection to " + connection->getEndpoint() +
-               " - Operations completed successfully");
+/**
+ * @brief Handle a failed accept, the acceptor keeps accepting unless it is
+ * broken
+ * Running out of descriptors or memory pauses accepting for ACCEPT_BACKOFF,
+ * a connection aborted before it was accepted is skipped. A broken acceptor
+ * shuts the server down as the idle timeout does
+ *
+ * @param errorCode of the accept
+ */
+void Server::onAcceptError(const asio::error_code & errorCode) {
+  if (errorCode == asio::error::bad_descriptor ||
+      errorCode == asio::error::not_socket ||
+      errorCode == asio::error::invalid_argument ||
+      errorCode == asio::error::operation_not_supported) {
+    crit("Accepting connection: " + errorCode.message() +
+         ", shutting down the server");
+    EBEnqueueMessage({gui, EBMSGType_t::SHUTDOWN});
+    EBEnqueueMessage({gui, EBMSGType_t::QUIT});
+    return;
+  }
+  if (errorCode == asio::error::no_descriptors ||
+      errorCode == asio::error::no_buffer_space ||
+      errorCode == asio::error::no_memory ||
+      (errorCode.category() == asio::error::get_system_category() &&
+          errorCode.value() == ENFILE)) {
+    warn("Accepting connection: " + errorCode.message() + ", retrying in " +
+         std::to_string(ACCEPT_BACKOFF.count()) + "ms");
+    workers.front()->getTimerWheel().schedule(*timerAccept, ACCEPT_BACKOFF);
+    return;
+  }
+  error("Accepting connection: " + errorCode.message());
+  startAccept();
+}
 
-        connection->stop();
-        delete connection;
-        i = connections.erase(i);
-      }
-    }
-    if (connections.empty()) {
-      if (timeoutTime ==
-          std::chrono::time_point<std::chrono::system_clock>::min()) {
-        timeoutTime = now + (firstConnectionMade ? TIMEOUT_NO_CONNECTIONS
-                                                 : TIMEOUT_FIRST_CONNECTIONS);
-      }
-      if (now > timeoutTime) {
-        // Server had no connections for the timeout time
-        EBEnqueueMessage({gui, EBMSGType_t::SHUTDOWN});
-        EBEnqueueMessage({gui, EBMSGType_t::QUIT});
-      }
-    } else {
-      timeoutTime = std::chrono::time_point<std::chrono::system_clock>::min();
-    }
+/**
+ * @brief Start the timer to shutdown the server once it has had no connections
+ * for the timeout time
+ * Must be called from the first worker's thread
+ * Does nothing if idle shutdown is disabled
+ *
+ */
+void Server::startTimeoutIdle() {
+  if (!IDLE_SHUTDOWN)
+    return;
+  workers.front()->getTimerWheel().schedule(*timerIdle,
+      firstConnectionMade ? TIMEOUT_NO_CONNECTIONS : TIMEOUT_FIRST_CONNECTIONS);
+}
 
-    if (outputMessageDispatched)
-      outputMessages.pop_front();
+/**
+ * @brief Handle the expiration of the idle timer, shutdown the server if it
+ * still has no connections
+ *
+ */
+void Server::onTimeoutIdle() {
+  if (connectionCount != 0)
+    return;
+  // Server had no connections for the timeout time
+  EBEnqueueMessage({gui, EBMSGType_t::SHUTDOWN});
+  EBEnqueueMessage({gui, EBMSGType_t::QUIT});
+}
 
-    // If nothing was processed this loop, sleep until the next to save CPU
-    // usage
-    if (!didSomething)
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-  }
-  // Free socket
-  if (socket != nullptr) {
-    socket->shutdown(asio::ip::tcp::socket::shutdown_both, errorCode);
-    socket->close(errorCode);
-    delete socket;
-    socket = nullptr;
-  }
+/**
+ * @brief Decrement the number of open connections, starting the idle timer
+ * when none remain
+ * Called from any worker's thread
+ *
+ */
+void Server::connectionClosed() {
+  if (--connectionCount != 0)
+    return;
+  asio::post(workers.front()->getIOContext(), [this]() {
+    if (connectionCount == 0)
+      startTimeoutIdle();
+  });
 }
 
 /**
- * @brief Stop the run thread
+ * @brief Stop the worker threads
  *
  */
 void Server::stop() {
-  running = false;
-  if (thread == nullptr)
-    return;
-  if (thread->joinable())
-    thread->join();
-  delete thread;
-  thread = nullptr;
-  for (Connection * connection : connections) {
-    connection->stop();
-    delete connection;
-  }
-  connections.clear();
+  for (Worker * worker : workers)
+    worker->stop();
+
+  asio::error_code errorCode;
+  acceptor->cancel(errorCode);
+  timerIdle->cancel();
+  timerAccept->cancel();
+  connectionCount = 0;
 }
 
 /**
  * @brief Enqueue a message to output to connected websockets
+ * Safe to call from any thread, never blocks. The message is encoded into a
+ * WebSocket frame once, the frame is shared by every worker and connection
+ * and dispatched on the workers' threads
+ *
+ * A worker with a full queue drops the message for its connections only, the
+ * drop is logged and counted by the worker. Returns
+ * ResultCode_t::BUFFER_OVERFLOW only if every worker dropped it, retrying
+ * after SUCCESS would send it twice
  *
  * @param msg to enqueue
+ * @param key of the properties the message updates, a message supersedes a
+ * queued message with the same key and targets, 0 for none
+ * @param targets the href and properties the message updates
+ * @return Result error code
  */
-void Server::enqueueOutput(const std::string & msg) {
-  outputMessages.push_back(msg);
+Result Server::enqueueOutput(
+    const std::string & msg, HashValue_t key, const std::string & targets) {
+  WebSocket::EncodedFramePtr_t frame =
+      WebSocket::Frame::encode(WebSocket::Opcode_t::TEXT, msg, key, targets);
+  Result result;
+  bool   accepted = false;
+  for (Worker * worker : workers) {
+    Result workerResult = worker->enqueueOutput(frame);
+    if (workerResult)
+      accepted = true;
+    else
+      result = workerResult;
+  }
+  if (!accepted)
+    return result + "Every worker dropped the output message";
+  return ResultCode_t::SUCCESS;
 }
 
 /**
@@ -266,5 +331,41 @@ const std::string & Server::getDomainName() const {
   return domainName;
 }
 
+/**
+ * @brief Get the routes of the server's dynamic requests
+ *
+ * @return HTTP::Router & router
+ */
+HTTP::Router & Server::getRouter() {
+  return router;
+}
+
+/**
+ * @brief Get the index of the server's http root
+ *
+ * @return HTTP::ResourceIndex & resource index
+ */
+HTTP::ResourceIndex & Server::getResourceIndex() {
+  return resourceIndex;
+}
+
+/**
+ * @brief Get the cache of the server's static files
+ *
+ * @return HTTP::AssetCache & asset cache
+ */
+HTTP::AssetCache & Server::getAssetCache() {
+  return assetCache;
+}
+
+/**
+ * @brief Get the compressor of the server's responses
+ *
+ * @return HTTP::Compressor & compressor
+ */
+HTTP::Compressor & Server::getCompressor() {
+  return compressor;
+}
+
 } // namespace Web
 } // namespace Ehbanana
\ No newline at end of file
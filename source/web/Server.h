@@ -1,18 +1,24 @@
 #ifndef _WEB_SERVER_H_
 #define _WEB_SERVER_H_
 
-#include "Connection.h"
 #include "Ehbanana.h"
+#include "HTTP/AssetCache.h"
+#include "HTTP/CacheControl.h"
+#include "HTTP/Compressor.h"
+#include "HTTP/MIMETypes.h"
+#include "HTTP/ResourceIndex.h"
+#include "HTTP/Router.h"
+#include "Worker.h"
 
 #include <FruitBowl.h>
 #include <asio.hpp>
 
 #include <atomic>
 #include <chrono>
-#include <list>
+#include <memory>
 #include <stdint.h>
 #include <string>
-#include <thread>
+#include <vector>
 
 namespace Ehbanana {
 namespace Web {
@@ -22,7 +28,8 @@ public:
   Server(const Server &) = delete;
   Server & operator=(const Server &) = delete;
 
-  Server(EBGUI_t gui, uint8_t timeoutIdle, uint8_t timeoutFirst);
+  Server(EBGUI_t gui, uint8_t timeoutIdle, uint8_t timeoutFirst,
+      uint8_t ioThreads = 1, bool idleShutdown = true);
   ~Server();
 
   Result configure(
@@ -31,31 +38,56 @@ public:
   void   start();
   void   stop();
 
-  void enqueueOutput(const std::string & msg);
+  Result enqueueOutput(const std::string & msg, HashValue_t key = 0,
+      const std::string & targets = "");
+  void   connectionClosed();
 
-  const std::string & getDomainName() const;
+  const std::string &   getDomainName() const;
+  HTTP::Router &        getRouter();
+  HTTP::ResourceIndex & getResourceIndex();
+  HTTP::AssetCache &    getAssetCache();
+  HTTP::Compressor &    getCompressor();
 
   static const uint16_t PORT_AUTO    = 0;
   static const uint16_t PORT_DEFAULT = 8080;
 
 private:
-  void run();
+  void startAccept();
+  void onAcceptError(const asio::error_code & errorCode);
+  void startTimeoutIdle();
+  void onTimeoutIdle();
 
-  std::thread *     thread  = nullptr;
-  std::atomic<bool> running = false;
+  // The first worker also runs the acceptor and idle timer
+  std::vector<Worker *> workers;
+  size_t                nextWorker = 0;
 
-  asio::io_context        ioContext;
-  asio::ip::tcp::acceptor acceptor;
+  asio::ip::tcp::acceptor * acceptor    = nullptr;
+  TimerWheel::Timer *       timerIdle   = nullptr;
+  TimerWheel::Timer *       timerAccept = nullptr;
+
+  // Out of descriptors, accepting is retried after a pause instead of
+  // spinning on the pending connection
+  static const std::chrono::milliseconds ACCEPT_BACKOFF;
 
   std::string domainName;
 
-  std::list<Connection *> connections;
-  std::list<std::string>  outputMessages;
+  // Routes of this GUI's application, registered from any thread
+  HTTP::Router router;
+
+  // Static files of this GUI's http root, configured from its settings
+  HTTP::CacheControl  cacheControl;
+  HTTP::MIMETypes     mimeTypes;
+  HTTP::ResourceIndex resourceIndex;
+  HTTP::Compressor    compressor;
+  HTTP::AssetCache    assetCache;
+
+  std::atomic<size_t> connectionCount {0};
 
   EBGUI_t gui;
 
   const std::chrono::seconds TIMEOUT_NO_CONNECTIONS;
   const std::chrono::seconds TIMEOUT_FIRST_CONNECTIONS;
+  const bool                 IDLE_SHUTDOWN;
 
   bool firstConnectionMade = false;
 };
@@ -0,0 +1,250 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+namespace Ehbanana {
+namespace Web {
+
+const std::chrono::milliseconds TimerWheel::TICK(10);
+
+/**
+ * @brief Construct a new TimerWheel::Timer object
+ *
+ * @param callback to call on the wheel's thread when the timer expires
+ */
+TimerWheel::Timer::Timer(Callback_t callback) : callback(callback) {}
+
+/**
+ * @brief Destroy the TimerWheel::Timer object
+ * Cancels the timer if pending
+ */
+TimerWheel::Timer::~Timer() {
+  cancel();
+}
+
+/**
+ * @brief Remove the timer from its wheel without calling its callback
+ *
+ */
+void TimerWheel::Timer::cancel() {
+  if (wheel == nullptr)
+    return;
+  unlink();
+  --wheel->count;
+  wheel = nullptr;
+}
+
+/**
+ * @brief Check if the timer is scheduled
+ *
+ * @return true if the timer is scheduled and has not expired
+ * @return false otherwise
+ */
+bool TimerWheel::Timer::isPending() const {
+  return wheel != nullptr;
+}
+
+/**
+ * @brief Link the timer to the end of a slot's list
+ *
+ * @param head sentinel of the slot
+ */
+void TimerWheel::Timer::link(Timer * head) {
+  prev       = head->prev;
+  next       = head;
+  prev->next = this;
+  head->prev = this;
+}
+
+/**
+ * @brief Unlink the timer from its slot's list
+ *
+ */
+void TimerWheel::Timer::unlink() {
+  prev->next = next;
+  next->prev = prev;
+  prev       = this;
+  next       = this;
+}
+
+/**
+ * @brief Construct a new TimerWheel object
+ *
+ * @param ioContext to run the expirations on
+ */
+TimerWheel::TimerWheel(asio::io_context & ioContext) :
+  timer(ioContext), start(std::chrono::steady_clock::now()) {}
+
+/**
+ * @brief Destroy the TimerWheel object
+ * Detaches any pending timers without calling their callbacks
+ */
+TimerWheel::~TimerWheel() {
+  for (uint8_t level = 0; level < LEVELS; ++level) {
+    for (Timer & head : slots[level]) {
+      while (head.next != &head)
+        head.next->cancel();
+    }
+  }
+  asio::error_code errorCode;
+  timer.cancel(errorCode);
+}
+
+/**
+ * @brief Schedule a timer to expire after the timeout
+ * A pending timer is rescheduled, expiring no earlier than the timeout and no
+ * later than the timeout plus one TICK
+ *
+ * @param timer to schedule
+ * @param timeout duration from now
+ */
+void TimerWheel::schedule(
+    Timer & timer, std::chrono::steady_clock::duration timeout) {
+  timer.cancel();
+  if (count == 0)
+    currentTick = now();
+
+  // Round up to the next tick
+  std::chrono::steady_clock::duration elapsed =
+      std::chrono::steady_clock::now() - start + timeout + TICK -
+      std::chrono::steady_clock::duration(1);
+  timer.expiry = static_cast<uint64_t>(elapsed / TICK);
+  timer.wheel  = this;
+  ++count;
+
+  arm(insert(timer));
+}
+
+/**
+ * @brief Insert a timer into the level and slot of its expiry
+ *
+ * @param timer to insert
+ * @return uint64_t tick the timer needs work: expiring in the lowest level or
+ * cascading from a higher one
+ */
+uint64_t TimerWheel::insert(Timer & timer) {
+  if (timer.expiry <= currentTick)
+    timer.expiry = currentTick + 1;
+  else if (timer.expiry - currentTick > MAX_TICKS)
+    timer.expiry = currentTick + MAX_TICKS;
+
+  uint64_t delta = timer.expiry - currentTick;
+  uint8_t  level = 0;
+  while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1))))
+    ++level;
+  uint8_t shift = SLOT_BITS * level;
+  timer.link(&slots[level][(timer.expiry >> shift) & SLOT_MASK]);
+  return (timer.expiry >> shift) << shift;
+}
+
+/**
+ * @brief Move the timers of the current slot of a level into the lower levels
+ *
+ * @param level to cascade
+ */
+void TimerWheel::cascade(uint8_t level) {
+  Timer & head = slots[level][(currentTick >> (SLOT_BITS * level)) & SLOT_MASK];
+  while (head.next != &head) {
+    Timer * timer = head.next;
+    timer->unlink();
+    insert(*timer);
+  }
+}
+
+/**
+ * @brief Advance the wheel up to the tick, expiring timers on the way
+ * Callbacks are copied before they are called so a timer may be destroyed by
+ * its own callback
+ *
+ * @param tick to advance to
+ */
+void TimerWheel::advance(uint64_t tick) {
+  while (count > 0) {
+    uint64_t next = nextTick();
+    if (next > tick)
+      break;
+    currentTick = next;
+
+    // Cascade each level whose slot starts at this tick
+    for (uint8_t level = 1; level < LEVELS; ++level) {
+      if ((currentTick & ((1ull << (SLOT_BITS * level)) - 1)) != 0)
+        break;
+      cascade(level);
+    }
+
+    Timer & head = slots[0][currentTick & SLOT_MASK];
+    while (head.next != &head) {
+      Timer * timer = head.next;
+      timer->cancel();
+      Callback_t callback = timer->callback;
+      callback();
+    }
+  }
+  currentTick = std::max(currentTick, tick);
+}
+
+/**
+ * @brief Arm the steady_timer to wake at the tick if earlier than it is already
+ * armed for
+ *
+ * @param tick to wake at, TICK_NEVER does nothing
+ */
+void TimerWheel::arm(uint64_t tick) {
+  if (tick >= armedTick)
+    return;
+  armedTick = tick;
+  timer.expires_at(start + tick * TICK);
+  timer.async_wait(
+      [this](const asio::error_code & errorCode) { onTimer(errorCode); });
+}
+
+/**
+ * @brief Handle the steady_timer waking, expire due timers and arm for the
+ * next tick with work
+ *
+ * @param errorCode of the steady_timer
+ */
+void TimerWheel::onTimer(const asio::error_code & errorCode) {
+  if (errorCode == asio::error::operation_aborted)
+    return;
+  armedTick = TICK_NEVER;
+  advance(now());
+  arm(nextTick());
+}
+
+/**
+ * @brief Get the next tick that has work: a lower level slot with timers to
+ * expire or a higher level slot with timers to cascade
+ *
+ * @return uint64_t tick, TICK_NEVER if no timers are pending
+ */
+uint64_t TimerWheel::nextTick() const {
+  if (count == 0)
+    return TICK_NEVER;
+  uint64_t tick = TICK_NEVER;
+  for (uint8_t level = 0; level < LEVELS; ++level) {
+    uint8_t  shift = SLOT_BITS * level;
+    uint64_t base  = currentTick >> shift;
+    for (uint32_t i = 1; i <= SLOTS; ++i) {
+      const Timer & head = slots[level][(base + i) & SLOT_MASK];
+      if (head.next != &head) {
+        tick = std::min(tick, (base + i) << shift);
+        break;
+      }
+    }
+  }
+  return tick;
+}
+
+/**
+ * @brief Get the current tick of the steady clock
+ *
+ * @return uint64_t ticks since the wheel started
+ */
+uint64_t TimerWheel::now() const {
+  return static_cast<uint64_t>(
+      (std::chrono::steady_clock::now() - start) / TICK);
+}
+
+} // namespace Web
+} // namespace Ehbanana
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef _WEB_TIMER_WHEEL_H_
+#define _WEB_TIMER_WHEEL_H_
+
+#include <asio.hpp>
+
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+
+namespace Ehbanana {
+namespace Web {
+
+/**
+ * @brief Hierarchical timer wheel driven by a single steady_timer
+ *
+ * Timers are placed into one of LEVELS wheels of SLOTS slots each, a level's
+ * slot spans SLOTS times the span of the level below. Scheduling and
+ * cancelling are O(1), expiring is O(expired) plus a cascade of one higher
+ * level slot each time a lower level wraps. The steady_timer is only armed
+ * when timers are pending, for the next tick that has work.
+ *
+ * Not thread safe, owned and used by a single io_context's thread
+ */
+class TimerWheel {
+public:
+  typedef std::function<void()> Callback_t;
+
+  class Timer {
+  public:
+    Timer(const Timer &) = delete;
+    Timer & operator=(const Timer &) = delete;
+
+    Timer(Callback_t callback);
+    ~Timer();
+
+    void cancel();
+    bool isPending() const;
+
+  private:
+    friend class TimerWheel;
+
+    Timer() {}
+
+    void link(Timer * head);
+    void unlink();
+
+    Callback_t   callback;
+    TimerWheel * wheel  = nullptr;
+    uint64_t     expiry = 0;
+
+    // Intrusive circular list, a slot's sentinel when not pending is itself
+    Timer * prev = this;
+    Timer * next = this;
+  };
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel & operator=(const TimerWheel &) = delete;
+
+  TimerWheel(asio::io_context & ioContext);
+  ~TimerWheel();
+
+  void schedule(Timer & timer, std::chrono::steady_clock::duration timeout);
+
+  static const std::chrono::milliseconds TICK;
+
+private:
+  uint64_t insert(Timer & timer);
+  void     cascade(uint8_t level);
+  void     advance(uint64_t tick);
+  void     arm(uint64_t tick);
+  void     onTimer(const asio::error_code & errorCode);
+
+  uint64_t nextTick() const;
+  uint64_t now() const;
+
+  static const uint8_t  LEVELS     = 4;
+  static const uint8_t  SLOT_BITS  = 6;
+  static const uint32_t SLOTS      = 1 << SLOT_BITS;
+  static const uint32_t SLOT_MASK  = SLOTS - 1;
+  static const uint64_t MAX_TICKS  = (1ull << (SLOT_BITS * LEVELS)) - 1;
+  static const uint64_t TICK_NEVER = UINT64_MAX;
+
+  Timer slots[LEVELS][SLOTS];
+
+  size_t   count       = 0;
+  uint64_t currentTick = 0;
+  uint64_t armedTick   = TICK_NEVER;
+
+  asio::steady_timer                    timer;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_TIMER_WHEEL_H_ */
\ No newline at end of file
@@ -38,9 +38,6 @@ Frame::Frame(const Frame & that) {
  */
 Frame & Frame::operator=(const Frame & that) {
   if (this != &that) {
-    this->buffer.clear();
-    this->buffer = that.buffer;
-
     this->data = that.data;
     this->data.shrink_to_fit();
 
@@ -102,8 +99,14 @@ Result Frame::decode(const uint8_t c) {
         opcode = static_cast<Opcode_t>(c & 0x0F);
         if (opcode == Opcode_t::BINARY) {
           // Generate a temporary file name
+#ifdef _WIN32
           if (tmpfile_s(&dataFile) != 0)
             return ResultCode_t::OPEN_FAILED + "Websocket frame temp file";
+#else
+          dataFile = tmpfile();
+          if (dataFile == nullptr)
+            return ResultCode_t::OPEN_FAILED + "Websocket frame temp file";
+#endif
         }
       }
       state = DecodeState_t::HEADER_PAYLOAD_LEN;
@@ -215,37 +218,53 @@ FILE * Frame::getDataFile(bool takeOwnership) {
 }
 
 /**
- * @brief Convert the frame into a buffer byte stream
+ * @brief Encode a complete, unmasked frame into an immutable buffer
+ * The buffer holds the header followed by the payload and is shared by every
+ * connection transmitting it, so a broadcast is only encoded once
  *
- * @return asio::const_buffer
+ * @param opcode of the frame
+ * @param payload of the frame
+ * @param key of the properties the payload updates, 0 for none
+ * @param targets the href and properties the payload updates
+ * @return EncodedFramePtr_t encoded frame
  */
-asio::const_buffer Frame::toBuffer() {
-  buffer.push_back(0x80 | static_cast<uint8_t>(opcode)); // FIN = 1
-  payloadLength = data.length();
+EncodedFramePtr_t Frame::encode(Opcode_t opcode, const std::string & payload,
+    HashValue_t key, const std::string & targets) {
+  uint64_t       length = payload.length();
+  EncodedFrame_t frame;
+  frame.key     = key;
+  frame.targets = targets;
+
+  std::string & buffer = frame.buffer;
+  buffer.reserve(10 + payload.length());
+  buffer.push_back(static_cast<char>(0x80 | static_cast<uint8_t>(opcode)));
   // No masking
-  if (payloadLength < 126) {
+  if (length < 126) {
     // 7b payloadLength
-    buffer.push_back(static_cast<uint8_t>(payloadLength));
-  } else if (payloadLength <= static_cast<size_t>(1 << 16)) {
+    buffer.push_back(static_cast<char>(length));
+  } else if (length <= 0xFFFF) {
     buffer.push_back(126); // 16b payload length
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 8) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 0) & 0xFF));
+    buffer.push_back(static_cast<char>((length >> 8) & 0xFF));
+    buffer.push_back(static_cast<char>((length >> 0) & 0xFF));
   } else {
     buffer.push_back(127); // 64b payload length
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 56) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 48) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 40) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 32) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 24) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 16) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 8) & 0xFF));
-    buffer.push_back(static_cast<uint8_t>((payloadLength >> 0) & 0xFF));
-  }
-  for (uint8_t c : data) {
-    buffer.push_back(c);
+    for (int shift = 56; shift >= 0; shift -= 8)
+      buffer.push_back(static_cast<char>((length >> shift) & 0xFF));
   }
+  buffer += payload;
+  return std::make_shared<const EncodedFrame_t>(std::move(frame));
+}
 
-  return asio::buffer(buffer);
+/**
+ * @brief Check if an encoded frame is a control frame: close, ping or pong
+ *
+ * @param frame to check
+ * @return true if the frame is a control frame
+ * @return false if the frame is a data frame
+ */
+bool Frame::isControl(const EncodedFramePtr_t & frame) {
+  // Control opcodes have the most significant bit of the opcode set
+  return (frame->buffer[0] & 0x08) == 0x08;
 }
 
 } // namespace WebSocket
@@ -4,6 +4,9 @@
 #include <FruitBowl.h>
 #include <asio.hpp>
 
+#include <memory>
+#include <string>
+
 namespace Ehbanana {
 namespace Web {
 namespace WebSocket {
@@ -17,6 +20,23 @@ enum class Opcode_t : uint8_t {
   PONG         = 0x0A,
 };
 
+/**
+ * @brief Encoded frame, immutable once built and shared between connections
+ *
+ * @param buffer header followed by the payload
+ * @param key of the properties the frame updates, a frame supersedes a queued
+ * frame with the same key and targets, 0 for none
+ * @param targets the href and properties the frame updates, compared when the
+ * keys are equal
+ */
+struct EncodedFrame_t {
+  std::string buffer;
+  HashValue_t key = 0;
+  std::string targets;
+};
+
+typedef std::shared_ptr<const EncodedFrame_t> EncodedFramePtr_t;
+
 class Frame {
 public:
   Frame();
@@ -31,10 +51,15 @@ public:
   const Opcode_t      getOpcode() const;
   const std::string & getData() const;
   FILE *              getDataFile(bool takeOwnership = false);
-  asio::const_buffer  toBuffer();
 
   void addData(const std::string & string);
 
+  static EncodedFramePtr_t encode(Opcode_t opcode,
+      const std::string & payload, HashValue_t key = 0,
+      const std::string & targets = "");
+
+  static bool isControl(const EncodedFramePtr_t & frame);
+
 private:
   Result decode(const uint8_t c);
 
@@ -49,8 +74,6 @@ private:
 
   DecodeState_t state = DecodeState_t::HEADER_OP_CODE;
 
-  std::vector<uint8_t> buffer;
-
   Opcode_t    opcode        = Opcode_t::CONTINUATION;
   uint64_t    payloadLength = 0;
   uint32_t    maskingKey    = 0;
@@ -4,6 +4,8 @@
 
 #include <rapidjson/document.h>
 
+#include <iterator>
+
 namespace Ehbanana {
 namespace Web {
 namespace WebSocket {
@@ -12,17 +14,16 @@ namespace WebSocket {
  * @brief Construct a new WebSocket::WebSocket object
  *
  * @param gui that owns this server
+ * @param endpoint of the connection
  */
-WebSocket::WebSocket(EBGUI_t gui) : gui(gui) {}
+WebSocket::WebSocket(EBGUI_t gui, const std::string & endpoint) :
+  gui(gui), endpoint(endpoint) {}
 
 /**
  * @brief Destroy the WebSocket::WebSocket object
  *
  */
-WebSocket::~WebSocket() {
-  for (Frame * frame : framesOut)
-    delete frame;
-}
+WebSocket::~WebSocket() {}
 
 /**
  * @brief Process a received buffer, could be the entire message or a fragment
@@ -50,10 +51,7 @@ Result WebSocket::processReceiveBuffer(const uint8_t * begin, size_t length) {
     case Opcode_t::PING: {
       debug("WebSocket received ping");
       // Send pong
-      Frame * frame = new Frame();
-      frame->addData(frameIn.getData());
-      frame->setOpcode(Opcode_t::PONG);
-      framesOut.push_back(frame);
+      queueFrame(Frame::encode(Opcode_t::PONG, frameIn.getData()));
       return ResultCode_t::INCOMPLETE;
     }
     case Opcode_t::PONG:
@@ -63,11 +61,7 @@ Result WebSocket::processReceiveBuffer(const uint8_t * begin, size_t length) {
     case Opcode_t::CLOSE:
       debug("WebSocket received close");
       // Echo the close back
-      Frame * frame = new Frame();
-      frame->addData(frameIn.getData());
-      frame->setOpcode(Opcode_t::CLOSE);
-      framesOut.push_back(frame);
-      addTransmitBuffer(frameIn.toBuffer());
+      queueFrame(Frame::encode(Opcode_t::CLOSE, frameIn.getData()));
       return ResultCode_t::SUCCESS;
   }
 
@@ -124,7 +118,9 @@ Result WebSocket::processFrameText() {
     return ResultCode_t::SUCCESS;
   }
 
-  EBEnqueueMessage(msg);
+  ResultCode_t resultCode = EBEnqueueMessage(msg);
+  if (!resultCode)
+    return resultCode + "Enqueueing input message";
   return ResultCode_t::SUCCESS;
 }
 
@@ -142,7 +138,13 @@ Result WebSocket::processFrameBinary() {
   }
   rewind(frameIn.getDataFile());
   msgAwaitingFile.file = frameIn.getDataFile(true);
-  EBEnqueueMessage(msgAwaitingFile);
+  ResultCode_t resultCode = EBEnqueueMessage(msgAwaitingFile);
+  if (!resultCode) {
+    // The application never receives the file, close it here
+    fclose(msgAwaitingFile.file);
+    msgAwaitingFile.file = nullptr;
+    return resultCode + "Enqueueing input message with file";
+  }
   return ResultCode_t::SUCCESS;
 }
 
@@ -166,10 +168,7 @@ bool WebSocket::sendAliveCheck() {
   if (pingSent)
     return true;
   // send ping
-  Frame * frame = new Frame();
-  frame->setOpcode(Opcode_t::PING);
-  frame->addData("Ping");
-  framesOut.push_back(frame);
+  queueFrame(Frame::encode(Opcode_t::PING, "Ping"));
   pingSent = true;
   return false;
 }
@@ -178,17 +177,87 @@ bool WebSocket::sendAliveCheck() {
  * @brief Add a message to transmit out if available
  * returns ResultCode_t::NOT_SUPPORTED if not compatible
  *
- * @param msg to add
+ * When the queue exceeds the send budget, the GUI's send policy applies.
+ * Returns ResultCode_t::BUFFER_OVERFLOW if the connection should be closed
+ *
+ * @param frame encoded message to add, shared with other connections
  * @return Result
  */
-Result WebSocket::addMessage(const std::string & msg) {
-  Frame * frame = new Frame();
-  frame->setOpcode(Opcode_t::TEXT);
-  frame->addData(msg);
-  framesOut.push_back(frame);
+Result WebSocket::addMessage(EncodedFramePtr_t frame) {
+  const EBGUISettings_t & settings = gui->settings;
+  if (settings.sendPolicy == EBSendPolicy_t::COALESCE && frame->key != 0) {
+    // Remove the superseded frame, skipping those transmitting already
+    std::list<EncodedFramePtr_t>::iterator i =
+        std::next(framesOut.begin(), framesTransmitting);
+    for (; i != framesOut.end(); ++i) {
+      if ((*i)->key == frame->key && (*i)->targets == frame->targets) {
+        bytesOut -= (*i)->buffer.size();
+        framesOut.erase(i);
+        break;
+      }
+    }
+  }
+  queueFrame(std::move(frame));
+  if (!isOverBudget())
+    return ResultCode_t::SUCCESS;
+
+  if (!congested) {
+    congested = true;
+    notify(EBMSGType_t::CONGESTED);
+  }
+  if (settings.sendPolicy == EBSendPolicy_t::DISCONNECT)
+    return ResultCode_t::BUFFER_OVERFLOW + "WebSocket send queue is full";
+
+  // Drop the oldest data frames, keeping the transmitting and newest frames
+  std::list<EncodedFramePtr_t>::iterator i =
+      std::next(framesOut.begin(), framesTransmitting);
+  while (isOverBudget() && std::next(i) != framesOut.end()) {
+    if (Frame::isControl(*i)) {
+      ++i;
+      continue;
+    }
+    bytesOut -= (*i)->buffer.size();
+    i = framesOut.erase(i);
+  }
   return ResultCode_t::SUCCESS;
 }
 
+/**
+ * @brief Add a frame to the end of the transmit queue
+ *
+ * @param frame to add
+ */
+void WebSocket::queueFrame(EncodedFramePtr_t frame) {
+  bytesOut += frame->buffer.size();
+  framesOut.push_back(std::move(frame));
+}
+
+/**
+ * @brief Check if the transmit queue exceeds the GUI's send budget
+ *
+ * @return true if there are too many frames or bytes queued
+ * @return false if the queue is within budget
+ */
+bool WebSocket::isOverBudget() const {
+  const EBGUISettings_t & settings = gui->settings;
+  if (settings.sendBudgetFrames != 0 &&
+      framesOut.size() > settings.sendBudgetFrames)
+    return true;
+  return settings.sendBudgetBytes != 0 && bytesOut > settings.sendBudgetBytes;
+}
+
+/**
+ * @brief Tell the GUI the connection's send queue changed state
+ * The message's id is the endpoint of the connection
+ *
+ * @param type CONGESTED or DRAINED
+ */
+void WebSocket::notify(EBMSGType_t type) {
+  EBMessage_t msg = {gui, type};
+  msg.id.add(endpoint.c_str());
+  EBEnqueueMessage(msg);
+}
+
 /**
  * @brief Update the transmit buffers with number of bytes transmitted
  * Removes buffers that have been completely transmitted. Moves the start
@@ -201,9 +270,15 @@ Result WebSocket::addMessage(const std::string & msg) {
 bool WebSocket::updateTransmitBuffers(size_t bytesWritten) {
   bool result = AppProtocol::updateTransmitBuffers(bytesWritten);
   if (result) {
-    // Remove the current frame;
-    delete framesOut.front();
-    framesOut.pop_front();
+    // Release the transmitted frames
+    for (; framesTransmitting > 0; --framesTransmitting) {
+      bytesOut -= framesOut.front()->buffer.size();
+      framesOut.pop_front();
+    }
+    if (congested && framesOut.empty()) {
+      congested = false;
+      notify(EBMSGType_t::DRAINED);
+    }
   }
   return result;
 }
@@ -211,6 +286,8 @@ bool WebSocket::updateTransmitBuffers(size_t bytesWritten) {
 /**
  * @brief Check if there are buffers in the transmit queue that have not been
  * transmitted
+ * Gathers the queued frames up to the write budget into the transmit buffers
+ * so they share a single write
  *
  * @return true when the transmit buffers are not empty
  * @return false when the transmit buffers are empty
@@ -218,11 +295,17 @@ bool WebSocket::updateTransmitBuffers(size_t bytesWritten) {
 bool WebSocket::hasTransmitBuffers() {
   if (AppProtocol::hasTransmitBuffers())
     return true;
-  if (!framesOut.empty()) {
-    addTransmitBuffer(framesOut.front()->toBuffer());
-    return true;
+  size_t bytes = 0;
+  for (const EncodedFramePtr_t & frame : framesOut) {
+    if (framesTransmitting == MAX_GATHER_FRAMES ||
+        (framesTransmitting != 0 &&
+            bytes + frame->buffer.size() > gui->settings.writeBudgetBytes))
+      break;
+    addTransmitBuffer(asio::buffer(frame->buffer));
+    bytes += frame->buffer.size();
+    ++framesTransmitting;
   }
-  return false;
+  return framesTransmitting != 0;
 }
 
 } // namespace WebSocket
@@ -1,7 +1,7 @@
 #ifndef _WEB_WEBSOCKET_WEBSOCKET_H_
 #define _WEB_WEBSOCKET_WEBSOCKET_H_
 
-#include "..\AppProtocol.h"
+#include "../AppProtocol.h"
 #include "Ehbanana.h"
 #include "Frame.h"
 
@@ -17,7 +17,7 @@ public:
   WebSocket(const WebSocket &) = delete;
   WebSocket & operator=(const WebSocket &) = delete;
 
-  WebSocket(EBGUI_t gui);
+  WebSocket(EBGUI_t gui, const std::string & endpoint);
   ~WebSocket();
 
   Result processReceiveBuffer(const uint8_t * begin, size_t length);
@@ -26,21 +26,34 @@ public:
   bool   hasTransmitBuffers();
   bool   isDone();
   bool   sendAliveCheck();
-  Result addMessage(const std::string & msg);
+  Result addMessage(EncodedFramePtr_t frame);
 
 private:
   Result processFrameText();
   Result processFrameBinary();
 
+  void queueFrame(EncodedFramePtr_t frame);
+  bool isOverBudget() const;
+  void notify(EBMSGType_t type);
+
   Frame frameIn;
 
-  std::list<Frame *> framesOut;
+  // asio gathers at most 64 buffers into one system call
+  static const size_t MAX_GATHER_FRAMES = 64;
+
+  std::list<EncodedFramePtr_t> framesOut;
+  size_t                       bytesOut           = 0;
+  size_t                       framesTransmitting = 0;
+  bool                         congested          = false;
 
   EBMessage_t msgAwaitingFile;
 
   bool pingSent = false;
 
   EBGUI_t gui;
+
+  // Of the connection, identifies it in CONGESTED and DRAINED messages
+  const std::string endpoint;
 };
 
 } // namespace WebSocket
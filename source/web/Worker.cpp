@@ -0,0 +1,181 @@
+#include "Worker.h"
+
+#include "EhbananaLog.h"
+#include "Server.h"
+
+namespace Ehbanana {
+namespace Web {
+
+/**
+ * @brief Construct a new Worker:: Worker object
+ *
+ * @param server that owns this worker
+ * @param gui that owns this server
+ */
+Worker::Worker(Server * server, EBGUI_t gui) :
+  ioContext(1), workGuard(asio::make_work_guard(ioContext)),
+  timerWheel(ioContext), outputMessages(OUTPUT_QUEUE_SIZE), server(server),
+  gui(gui) {}
+
+/**
+ * @brief Destroy the Worker:: Worker object
+ * Safely stop the thread and any open connections
+ */
+Worker::~Worker() {
+  stop();
+}
+
+/**
+ * @brief Start the run thread
+ *
+ */
+void Worker::start() {
+  stop();
+  ioContext.restart();
+  thread = new std::thread(&Worker::run, this);
+}
+
+/**
+ * @brief Stop the run thread and close the connections
+ *
+ */
+void Worker::stop() {
+  if (thread == nullptr)
+    return;
+  ioContext.stop();
+  if (thread->joinable())
+    thread->join();
+  delete thread;
+  thread = nullptr;
+
+  for (std::shared_ptr<Connection> connection : connections)
+    connection->stop();
+  connections.clear();
+}
+
+/**
+ * @brief Execute thread operations
+ * Runs the handlers of this worker's connections as they become ready, blocks
+ * until the worker is stopped
+ *
+ */
+void Worker::run() {
+  ioContext.run();
+}
+
+/**
+ * @brief Add a connection to the worker and start it on the worker's thread
+ *
+ * @param socket accepted on this worker's io_context
+ * @param endpoint socket is connected to
+ */
+void Worker::addConnection(
+    asio::ip::tcp::socket socket, const std::string & endpoint) {
+  std::shared_ptr<Connection> connection =
+      std::make_shared<Connection>(std::move(socket), endpoint, this, gui);
+  asio::post(ioContext, [this, connection]() {
+    connections.push_back(connection);
+    connection->start();
+  });
+}
+
+/**
+ * @brief Remove a completed connection and delete it once its operations
+ * complete, log the reason it closed
+ * Must be called from the worker's thread
+ *
+ * @param connection to remove
+ * @param result of the connection
+ */
+void Worker::removeConnection(
+    std::shared_ptr<Connection> connection, const Result & result) {
+  if (result == ResultCode_t::TIMEOUT)
+    info("Closing connection to " + connection->getEndpoint() + " - Timeout");
+  else if (!result)
+    error("Closing connection to " + connection->getEndpoint() + " - " +
+          result.getMessage());
+  else
+    info("Closing connection to " + connection->getEndpoint() +
+         " - Operations completed successfully");
+
+  connection->stop();
+  connections.remove(connection);
+  server->connectionClosed();
+}
+
+/**
+ * @brief Enqueue a message to output to this worker's connected websockets
+ * Safe to call from any thread, never blocks. The message is shared between
+ * the workers. The worker's thread is woken once per batch of messages
+ *
+ * Returns ResultCode_t::BUFFER_OVERFLOW if the worker's queue is full, the
+ * message is dropped for this worker's connections. The first drop of a run
+ * is logged, every drop is counted
+ *
+ * @param msg encoded WebSocket frame to enqueue
+ * @return Result error code
+ */
+Result Worker::enqueueOutput(WebSocket::EncodedFramePtr_t msg) {
+  if (!outputMessages.push(std::move(msg))) {
+    ++outputDropped;
+    if (outputDroppedRun++ == 0)
+      warn("Worker output queue is full, dropping messages");
+    return ResultCode_t::BUFFER_OVERFLOW + "Worker output queue is full";
+  }
+  size_t run = outputDroppedRun.exchange(0);
+  if (run != 0)
+    warn("Worker output queue dropped " + std::to_string(run) + " messages");
+  if (!outputPending.exchange(true))
+    asio::post(ioContext, [this]() { dispatchOutput(); });
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Get the number of output messages dropped while the queue was full
+ *
+ * @return size_t messages dropped
+ */
+size_t Worker::getOutputDropped() const {
+  return outputDropped;
+}
+
+/**
+ * @brief Add the queued output messages to this worker's connections
+ * Must be called from the worker's thread
+ *
+ */
+void Worker::dispatchOutput() {
+  // Clear before draining, a message pushed after the drain wakes again
+  outputPending = false;
+  WebSocket::EncodedFramePtr_t msg;
+  while (outputMessages.pop(msg)) {
+    std::list<std::shared_ptr<Connection>>::iterator i = connections.begin();
+    while (i != connections.end()) {
+      // Advance first, adding the message may remove the connection
+      std::shared_ptr<Connection> connection = *i++;
+      connection->addMessage(msg);
+    }
+  }
+}
+
+/**
+ * @brief Get the io_context the worker runs
+ *
+ * @return asio::io_context&
+ */
+asio::io_context & Worker::getIOContext() {
+  return ioContext;
+}
+
+/**
+ * @brief Get the timer wheel of the worker
+ * Must only be used from the worker's thread
+ *
+ * @return TimerWheel&
+ */
+TimerWheel & Worker::getTimerWheel() {
+  return timerWheel;
+}
+
+} // namespace Web
+} // namespace Ehbanana
\ No newline at end of file
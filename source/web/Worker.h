@@ -0,0 +1,77 @@
+#ifndef _WEB_WORKER_H_
+#define _WEB_WORKER_H_
+
+#include "Connection.h"
+#include "Ehbanana.h"
+#include "MPSCRing.h"
+#include "TimerWheel.h"
+
+#include <FruitBowl.h>
+#include <asio.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+namespace Ehbanana {
+namespace Web {
+
+class Server;
+
+class Worker {
+public:
+  Worker(const Worker &) = delete;
+  Worker & operator=(const Worker &) = delete;
+
+  Worker(Server * server, EBGUI_t gui);
+  ~Worker();
+
+  void start();
+  void stop();
+
+  void addConnection(
+      asio::ip::tcp::socket socket, const std::string & endpoint);
+  void removeConnection(
+      std::shared_ptr<Connection> connection, const Result & result);
+
+  Result enqueueOutput(WebSocket::EncodedFramePtr_t msg);
+  size_t getOutputDropped() const;
+
+  asio::io_context & getIOContext();
+  TimerWheel &       getTimerWheel();
+
+private:
+  void run();
+  void dispatchOutput();
+
+  std::thread * thread = nullptr;
+
+  asio::io_context ioContext;
+
+  // Keeps the context running while the worker has no connections
+  asio::executor_work_guard<asio::io_context::executor_type> workGuard;
+
+  TimerWheel timerWheel;
+
+  std::list<std::shared_ptr<Connection>> connections;
+
+  static const size_t OUTPUT_QUEUE_SIZE = 1024;
+
+  MPSCRing<WebSocket::EncodedFramePtr_t> outputMessages;
+  std::atomic<bool>                      outputPending {false};
+
+  // Messages dropped while the queue was full, and in the current run of drops
+  std::atomic<size_t> outputDropped {0};
+  std::atomic<size_t> outputDroppedRun {0};
+
+  Server * server;
+  EBGUI_t  gui;
+};
+
+} // namespace Web
+} // namespace Ehbanana
+
+#endif /* _WEB_WORKER_H_ */
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "GUI.h"
 
-#include <thread>
+#include <chrono>
 
 namespace GUI {
 
@@ -18,7 +18,7 @@ GUI::~GUI() {
  * @param msg to process
  * @return ResultCode_t error code
  */
-ResultCode_t __stdcall GUI::guiProcess(const EBMessage_t & msg) {
+ResultCode_t EHBANANA_CALLBACK GUI::guiProcess(const EBMessage_t & msg) {
   switch (msg.type) {
     case EBMSGType_t::STARTUP:
       printf("Server starting up");
@@ -26,6 +26,12 @@ ResultCode_t __stdcall GUI::guiProcess(const EBMessage_t & msg) {
     case EBMSGType_t::SHUTDOWN:
       printf("Server shutting down");
       break;
+    case EBMSGType_t::CONGESTED:
+      printf("Server output congested: %s", msg.id.getString().c_str());
+      break;
+    case EBMSGType_t::DRAINED:
+      printf("Server output drained: %s", msg.id.getString().c_str());
+      break;
     case EBMSGType_t::INPUT: {
       Result result = GUI::GUI::Instance()->handleInput(msg);
       if (!result)
@@ -73,26 +79,31 @@ Result GUI::run() {
   EBMessage_t msg;
   auto        nextPeriodic = clockStd_t::now();
   auto        now          = clockStd_t::now();
-  while ((result = EBGetMessage(msg)) == ResultCode_t::INCOMPLETE ||
+  uint32_t    timeout      = 0;
+  // Sleep until a message arrives or the next periodic update is due
+  while ((result = EBWaitMessage(msg, timeout)) == ResultCode_t::INCOMPLETE ||
          result == ResultCode_t::NO_OPERATION) {
-    // If no messages were processed, wait a bit to save CPU
-    if (result == ResultCode_t::NO_OPERATION) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    } else {
+    if (result == ResultCode_t::INCOMPLETE) {
       result = EBDispatchMessage(msg);
       if (!result)
         return result + "EBDispatchMessage";
     }
 
     now = clockStd_t::now();
-    if (now > nextPeriodic) {
+    if (now >= nextPeriodic) {
       nextPeriodic += std::chrono::milliseconds(500);
       result = root->sendUpdate();
       if (!result)
         return result + "Sending periodic update";
     }
+    timeout = 0;
+    if (nextPeriodic > now)
+      timeout = static_cast<uint32_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              nextPeriodic - now)
+              .count());
   }
-  return result + "EBGetMessage";
+  return result + "EBWaitMessage";
 }
 
 /**
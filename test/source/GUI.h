@@ -30,7 +30,7 @@ public:
 
   Result handleInput(const EBMessage_t & msg);
 
-  static ResultCode_t __stdcall guiProcess(const EBMessage_t & msg);
+  static ResultCode_t EHBANANA_CALLBACK guiProcess(const EBMessage_t & msg);
 
 private:
   /**
@@ -3,6 +3,8 @@
 #include <algorithm/sha1.hpp>
 #include <base64.h>
 
+#include <algorithm>
+
 namespace GUI {
 
 /**
@@ -1,8 +1,13 @@
 #include <Ehbanana.h>
+
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #include "GUI.h"
 
+#include <iostream>
+
 /**
  * @brief Logger callback
  * Prints the message string to the destination stream, default: stdout
@@ -10,7 +15,8 @@
  * @param EBLogLevel_t log level
  * @param char * string
  */
-void __stdcall logEhbanana(const EBLogLevel_t level, const char * string) {
+void EHBANANA_CALLBACK logEhbanana(
+    const EBLogLevel_t level, const char * string) {
   switch (level) {
     case EBLogLevel_t::EB_DEBUG:
       printf("[Debug] %s\n", string);
@@ -30,21 +36,12 @@ void __stdcall logEhbanana(const EBLogLevel_t level, const char * string) {
   }
 }
 
-int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
-  if (AllocConsole()) {
-    HWND hwnd = GetConsoleWindow();
-    if (hwnd != NULL) {
-      HMENU hMenu = GetSystemMenu(hwnd, FALSE);
-      if (hMenu != NULL)
-        DeleteMenu(hMenu, SC_CLOSE, MF_BYCOMMAND);
-    }
-    freopen_s((FILE **)stdout, "CONOUT$", "w", stdout);
-  } else {
-    MessageBoxA(NULL, "Log console initialization failed", "Error", MB_OK);
-    std::cout << "Failed to AllocConsole with Win32 error: " << GetLastError()
-              << std::endl;
-  }
-
+/**
+ * @brief Run the test GUI until it completes
+ *
+ * @return int exit code
+ */
+int run() {
   printf("Ehbanana test starting\n");
 
   EBSetLogger(logEhbanana);
@@ -69,4 +66,28 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 
   printf("Ehbanana test complete");
   return static_cast<int>(ResultCode_t::SUCCESS);
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
+  if (AllocConsole()) {
+    HWND hwnd = GetConsoleWindow();
+    if (hwnd != NULL) {
+      HMENU hMenu = GetSystemMenu(hwnd, FALSE);
+      if (hMenu != NULL)
+        DeleteMenu(hMenu, SC_CLOSE, MF_BYCOMMAND);
+    }
+    freopen_s((FILE **)stdout, "CONOUT$", "w", stdout);
+  } else {
+    MessageBoxA(NULL, "Log console initialization failed", "Error", MB_OK);
+    std::cout << "Failed to AllocConsole with Win32 error: " << GetLastError()
+              << std::endl;
+  }
+
+  return run();
+}
+#else
+int main() {
+  return run();
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "web/HTTP/Body.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace Ehbanana::Web::HTTP;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed, split at %zu\n", __FILE__, __LINE__,   \
+          #condition, split);                                                  \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+// Near misses of the delimiter and a carriage return right before it, so
+// splits land inside a delimiter and inside data that only looks like one
+static const std::string BOUNDARY = "XyZ";
+static const std::string BODY =
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"a\"\r\n"
+    "\r\n"
+    "hello\r\n--XyY\r\n--Xy\rworld\r"
+    "\r\n--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"f\"; filename=\"x.txt\"\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "FILE\r\nDATA"
+    "\r\n--XyZ--\r\n"
+    "epilogue";
+
+/**
+ * @brief Write the body in fragments and check its parts
+ *
+ * @param split size of the first fragment
+ * @param step size of the following fragments
+ */
+static void check(size_t split, size_t step) {
+  RequestHeaders headers;
+  HeaderHash_t   header;
+  header.name.add("Content-Type");
+  header.value.add(("multipart/form-data; boundary=" + BOUNDARY).c_str());
+  CHECK(headers.addHeader(header));
+
+  Body body;
+  CHECK(body.open(headers));
+  const uint8_t * data = reinterpret_cast<const uint8_t *>(BODY.data());
+  CHECK(body.write(data, split));
+  for (size_t i = split; i < BODY.size(); i += step)
+    CHECK(body.write(data + i, std::min(step, BODY.size() - i)));
+  CHECK(body.close());
+
+  const BodyPart_t * a = body.getPart("a");
+  CHECK(a != nullptr && a->file == nullptr);
+  CHECK(a->data == "hello\r\n--XyY\r\n--Xy\rworld\r");
+
+  const BodyPart_t * f = body.getPart("f");
+  CHECK(f != nullptr && f->file != nullptr && f->fileName == "x.txt");
+  CHECK(f->size == 10);
+  char buffer[16] = {0};
+  CHECK(fread(buffer, 1, sizeof(buffer), f->file) == 10);
+  CHECK(std::string(buffer) == "FILE\r\nDATA");
+}
+
+int main() {
+  // Every split of two fragments, then of many small ones
+  for (size_t split = 0; split <= BODY.size(); ++split)
+    check(split, BODY.size());
+  for (size_t split = 1; split <= 8; ++split)
+    check(split, split);
+  puts("Body: multipart delimiters split across fragments parsed");
+  return EXIT_SUCCESS;
+}
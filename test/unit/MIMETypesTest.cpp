@@ -0,0 +1,124 @@
+#include "web/HTTP/MIMETypes.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace Ehbanana::Web::HTTP;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+static const std::string UNKNOWN = "application/octet-stream";
+
+/**
+ * @brief Write a mime.types file and load it
+ *
+ * @param types to populate
+ * @param contents of the file
+ * @return Result error code of loading it
+ */
+static Result populate(MIMETypes & types, const std::string & contents) {
+  std::string fileName =
+      (std::filesystem::temp_directory_path() / "EhbananaMIMETypesTest.types")
+          .string();
+  {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file << contents;
+  }
+  Result result = types.populateList(fileName);
+  std::filesystem::remove(fileName);
+  return result;
+}
+
+/**
+ * @brief Hash an extension the way the table does, FNV-1a
+ *
+ * @param extension lowercase
+ * @return uint32_t hash
+ */
+static uint32_t hash(const std::string & extension) {
+  uint32_t value = 2166136261u;
+  for (char c : extension) {
+    value ^= static_cast<uint8_t>(c);
+    value *= 16777619u;
+  }
+  return value;
+}
+
+int main() {
+  MIMETypes types;
+  CHECK(types.getType("/index.html", true) == UNKNOWN);
+
+  // Extensions match in any case, the first type of one is kept
+  CHECK(populate(types,
+      ".html text/html\r\n"
+      ".CSS text/css\n"
+      "# comment\n"
+      "\n"
+      "json application/json\n"
+      ".html text/plain\n"
+      ".js application/javascript"));
+  CHECK(types.getType("/index.html", true) == "text/html");
+  CHECK(types.getType("/INDEX.HTML", true) == "text/html");
+  CHECK(types.getType("/css/style.css", true) == "text/css");
+  CHECK(types.getType("/app.min.js", true) == "application/javascript");
+  CHECK(types.getType("/data.json", true) == UNKNOWN);
+
+  // The extension follows the last dot of the last path segment
+  CHECK(types.getType("/v1.2/readme", true) == UNKNOWN);
+  CHECK(types.getType("/archive.html.gz", true) == UNKNOWN);
+  CHECK(types.getType("/noextension", true) == UNKNOWN);
+  CHECK(types.getType("/trailing.", true) == UNKNOWN);
+
+  // Extensions whose hashes share a slot of the smallest table are probed
+  // past each other, a missing one probes until an empty slot
+  std::string first = "a0";
+  std::string second;
+  std::string missing;
+  for (int i = 1; missing.empty(); ++i) {
+    std::string extension = "a" + std::to_string(i);
+    if ((hash(extension) & 15) != (hash(first) & 15))
+      continue;
+    if (second.empty())
+      second = extension;
+    else
+      missing = extension;
+  }
+  CHECK(populate(types,
+      "." + first + " type/first\n." + second + " type/second\n"));
+  CHECK(types.getType("/file." + first, true) == "type/first");
+  CHECK(types.getType("/file." + second, true) == "type/second");
+  CHECK(types.getType("/file." + missing, true) == UNKNOWN);
+
+  // The table grows to hold many types, loading again replaces them
+  std::string many;
+  for (int i = 0; i < 5000; ++i)
+    many += ".x" + std::to_string(i) + " type/" + std::to_string(i) + "\n";
+  CHECK(populate(types, many));
+  for (int i = 0; i < 5000; ++i) {
+    CHECK(types.getType("/f.x" + std::to_string(i), true) ==
+          "type/" + std::to_string(i));
+    CHECK(types.getType("/f.X" + std::to_string(i), true) ==
+          "type/" + std::to_string(i));
+  }
+  CHECK(types.getType("/f.x5000", true) == UNKNOWN);
+  CHECK(types.getType("/file." + first, true) == UNKNOWN);
+  CHECK(populate(types, ".html text/html\n"));
+  CHECK(types.getType("/f.x1", true) == UNKNOWN);
+  CHECK(types.getType("/index.html", true) == "text/html");
+
+  // A missing file is an error
+  CHECK(types.populateList("/nonexistent/mime.types") ==
+        ResultCode_t::OPEN_FAILED);
+
+  puts("MIMETypes: types found");
+  return EXIT_SUCCESS;
+}
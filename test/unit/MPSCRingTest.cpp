@@ -0,0 +1,85 @@
+#include "web/MPSCRing.h"
+
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+using namespace Ehbanana::Web;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+int main() {
+  // The capacity rounds up to a power of 2, an empty ring pops nothing
+  MPSCRing<int> ring(3);
+  int           value = -1;
+  CHECK(!ring.pop(value));
+  CHECK(value == -1);
+  for (int i = 0; i < 4; ++i)
+    CHECK(ring.push(int(i)));
+  CHECK(!ring.push(4));
+
+  // Values come out in order, the positions wrap around many times
+  int next = 4;
+  for (int i = 0; i < 1000; ++i) {
+    CHECK(ring.pop(value));
+    CHECK(value == i);
+    CHECK(ring.push(int(next++)));
+  }
+  for (int i = 1000; i < 1004; ++i) {
+    CHECK(ring.pop(value));
+    CHECK(value == i);
+  }
+  CHECK(!ring.pop(value));
+
+  // A full ring leaves the value untouched, popped values are moved out
+  MPSCRing<std::unique_ptr<int>> owners(2);
+  std::unique_ptr<int>           rejected(new int(7));
+  std::unique_ptr<int>           owned;
+  CHECK(owners.push(std::unique_ptr<int>(new int(1))));
+  CHECK(owners.push(std::unique_ptr<int>(new int(2))));
+  CHECK(!owners.push(std::move(rejected)));
+  CHECK(rejected != nullptr && *rejected == 7);
+  CHECK(owners.pop(owned) && *owned == 1);
+  CHECK(owners.pop(owned) && *owned == 2);
+  CHECK(!owners.pop(owned));
+
+  // Every value of several producers arrives once, each producer's in order
+  const int                PRODUCERS = 4;
+  const int                COUNT     = 100000;
+  MPSCRing<int>            shared(64);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; ++p) {
+    producers.emplace_back([&shared, p]() {
+      for (int i = 0; i < COUNT; ++i) {
+        while (!shared.push(p * COUNT + i))
+          std::this_thread::yield();
+      }
+    });
+  }
+  std::vector<int> last(PRODUCERS, -1);
+  for (int received = 0; received < PRODUCERS * COUNT;) {
+    if (!shared.pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    int producer = value / COUNT;
+    CHECK(producer >= 0 && producer < PRODUCERS);
+    CHECK(value % COUNT == last[producer] + 1);
+    last[producer] = value % COUNT;
+    ++received;
+  }
+  for (std::thread & producer : producers)
+    producer.join();
+  CHECK(!shared.pop(value));
+
+  puts("MPSCRing: values passed in order");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+#include "web/HTTP/Date.h"
+#include "web/HTTP/RequestHeaders.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace Ehbanana::Web::HTTP;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+typedef RequestHeaders::Connection_t Connection_t;
+
+/**
+ * @brief Parse a header into a new set of headers
+ *
+ * @param headers to add to
+ * @param name of the header
+ * @param value of the header
+ * @return Result error code of adding it
+ */
+static Result add(
+    RequestHeaders & headers, const char * name, const std::string & value) {
+  HeaderHash_t header;
+  header.name.add(name);
+  header.value.add(value.c_str());
+  return headers.addHeader(header);
+}
+
+/**
+ * @brief Get the connection option of a Connection header
+ *
+ * @param value of the header
+ * @return Connection_t option
+ */
+static Connection_t connection(const std::string & value) {
+  RequestHeaders headers;
+  CHECK(add(headers, "Connection", value));
+  return headers.getConnection();
+}
+
+/**
+ * @brief Parse a Content-Length header into a new set of headers
+ *
+ * @param value of the header
+ * @param length to return when valid
+ * @return Result error code of adding it
+ */
+static Result contentLength(const std::string & value, size_t & length) {
+  RequestHeaders headers;
+  Result         result = add(headers, "Content-Length", value);
+  length                = headers.getContentLength();
+  return result;
+}
+
+/**
+ * @brief Get the ranges of a Range header for a representation
+ *
+ * @param value of the header
+ * @param size of the representation
+ * @param ranges to return
+ * @return Result error code of getting them
+ */
+static Result getRanges(const std::string & value, size_t size,
+    std::vector<ByteRange_t> & ranges) {
+  RequestHeaders headers;
+  CHECK(add(headers, "Range", value));
+  CHECK(headers.hasRange());
+  return headers.getRanges(size, ranges);
+}
+
+/**
+ * @brief Check a range is at the positions
+ *
+ * @param range to check
+ * @param first position expected
+ * @param last position expected
+ * @return true if the range matches
+ */
+static bool isRange(const ByteRange_t & range, size_t first, size_t last) {
+  return range.first == first && range.last == last;
+}
+
+/**
+ * @brief Check if a conditional request can be answered with 304
+ *
+ * @param name of the conditional header
+ * @param value of the header
+ * @param etag of the representation
+ * @param modified time of the representation
+ * @return true if the client's copy is current
+ */
+static bool isNotModified(const char * name, const std::string & value,
+    const std::string & etag, time_t modified) {
+  RequestHeaders headers;
+  CHECK(add(headers, name, value));
+  return headers.isNotModified(etag, modified);
+}
+
+int main() {
+  // Connection is a list of options in any case, upgrade wins over the
+  // others and close over keep-alive
+  CHECK(connection("keep-alive") == Connection_t::KEEP_ALIVE);
+  CHECK(connection("Keep-Alive") == Connection_t::KEEP_ALIVE);
+  CHECK(connection("close") == Connection_t::CLOSE);
+  CHECK(connection("CLOSE") == Connection_t::CLOSE);
+  CHECK(connection("upgrade") == Connection_t::UPGRADE);
+  CHECK(connection("keep-alive, Upgrade") == Connection_t::UPGRADE);
+  CHECK(connection("Upgrade, keep-alive") == Connection_t::UPGRADE);
+  CHECK(connection("keep-alive,Upgrade") == Connection_t::UPGRADE);
+  CHECK(connection(" upgrade\t,close") == Connection_t::UPGRADE);
+  CHECK(connection("keep-alive, close") == Connection_t::CLOSE);
+  CHECK(connection("close, keep-alive") == Connection_t::CLOSE);
+  CHECK(connection("TE, keep-alive") == Connection_t::KEEP_ALIVE);
+  CHECK(connection("TE") == Connection_t::NOT_SET);
+  CHECK(connection(", ,") == Connection_t::NOT_SET);
+  CHECK(connection("") == Connection_t::NOT_SET);
+
+  // Content-Length is decimal digits that fit, anything else is a bad request
+  size_t length = 0;
+  CHECK(contentLength("0", length) && length == 0);
+  CHECK(contentLength("1234", length) && length == 1234);
+  CHECK(contentLength("000000000000000042", length) && length == 42);
+  CHECK(contentLength("999999999999999999", length) &&
+        length == 999999999999999999ull);
+  CHECK(contentLength("", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("-1", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("+1", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("12a", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("1 2", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("0x10", length) == ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("1000000000000000000", length) ==
+        ResultCode_t::INVALID_DATA);
+  CHECK(contentLength("99999999999999999999999", length) ==
+        ResultCode_t::INVALID_DATA);
+  RequestHeaders repeated;
+  CHECK(add(repeated, "Content-Length", "5"));
+  CHECK(add(repeated, "Content-Length", "5"));
+  CHECK(add(repeated, "Content-Length", "6") == ResultCode_t::INVALID_DATA);
+
+  // Ranges are clipped to the representation, a suffix is its last bytes
+  std::vector<ByteRange_t> ranges;
+  CHECK(getRanges("bytes=0-99", 1000, ranges));
+  CHECK(ranges.size() == 1 && isRange(ranges[0], 0, 99));
+  CHECK(getRanges("bytes=900-", 1000, ranges));
+  CHECK(ranges.size() == 1 && isRange(ranges[0], 900, 999));
+  CHECK(getRanges("bytes=-100", 1000, ranges));
+  CHECK(ranges.size() == 1 && isRange(ranges[0], 900, 999));
+  CHECK(getRanges("bytes=-5000", 1000, ranges));
+  CHECK(ranges.size() == 1 && isRange(ranges[0], 0, 999));
+  CHECK(getRanges("bytes=500-5000", 1000, ranges));
+  CHECK(ranges.size() == 1 && isRange(ranges[0], 500, 999));
+  CHECK(getRanges("bytes=999999999999999999-", 1000, ranges) ==
+        ResultCode_t::INVALID_DATA);
+
+  // Overlapping ranges are kept as requested, unsatisfiable ones skipped
+  CHECK(getRanges("bytes=0-9, 5-14,2000-3000, -0, 20-", 30, ranges));
+  CHECK(ranges.size() == 3);
+  CHECK(isRange(ranges[0], 0, 9));
+  CHECK(isRange(ranges[1], 5, 14));
+  CHECK(isRange(ranges[2], 20, 29));
+
+  // No satisfiable range is 416 Range Not Satisfiable
+  CHECK(getRanges("bytes=1000-", 1000, ranges) == ResultCode_t::INVALID_DATA);
+  CHECK(getRanges("bytes=1000-2000, 5000-", 1000, ranges) ==
+        ResultCode_t::INVALID_DATA);
+  CHECK(getRanges("bytes=-0", 1000, ranges) == ResultCode_t::INVALID_DATA);
+  CHECK(getRanges("bytes=0-", 0, ranges) == ResultCode_t::INVALID_DATA);
+
+  // Malformed, other units, positions too long to parse and too many ranges
+  // are ignored, the whole representation is sent
+  CHECK(getRanges("items=0-9", 1000, ranges) == ResultCode_t::NO_OPERATION);
+  CHECK(getRanges("bytes=9-0", 1000, ranges) == ResultCode_t::NO_OPERATION);
+  CHECK(getRanges("bytes=-", 1000, ranges) == ResultCode_t::NO_OPERATION);
+  CHECK(getRanges("bytes=a-9", 1000, ranges) == ResultCode_t::NO_OPERATION);
+  CHECK(getRanges("bytes=0-9-", 1000, ranges) == ResultCode_t::NO_OPERATION);
+  CHECK(getRanges("bytes=0-9999999999999999999", 1000, ranges) ==
+        ResultCode_t::NO_OPERATION);
+  std::string many = "bytes=0-0";
+  for (int i = 1; i < 17; ++i)
+    many += "," + std::to_string(i) + "-" + std::to_string(i);
+  CHECK(getRanges(many, 1000, ranges) == ResultCode_t::NO_OPERATION);
+
+  // If-None-Match lists ETags, compared weakly, or matches any with *
+  const std::string ETAG     = "\"5f3a-1c2\"";
+  const time_t      MODIFIED = 1600000000;
+  CHECK(isNotModified("If-None-Match", ETAG, ETAG, MODIFIED));
+  CHECK(isNotModified("If-None-Match", "W/" + ETAG, ETAG, MODIFIED));
+  CHECK(isNotModified("If-None-Match", "*", ETAG, MODIFIED));
+  CHECK(isNotModified(
+      "If-None-Match", "\"other\", " + ETAG + " ", ETAG, MODIFIED));
+  CHECK(!isNotModified("If-None-Match", "\"other\"", ETAG, MODIFIED));
+  CHECK(!isNotModified("If-None-Match", "5f3a-1c2", ETAG, MODIFIED));
+  CHECK(!isNotModified("If-None-Match", ETAG + "-gz", ETAG, MODIFIED));
+
+  // If-Modified-Since is current unless modified after it
+  const std::string DATE = formatDate(MODIFIED);
+  CHECK(isNotModified("If-Modified-Since", DATE, ETAG, MODIFIED));
+  CHECK(isNotModified("If-Modified-Since", DATE, ETAG, MODIFIED - 60));
+  CHECK(!isNotModified("If-Modified-Since", DATE, ETAG, MODIFIED + 1));
+  CHECK(!isNotModified("If-Modified-Since", "yesterday", ETAG, MODIFIED));
+
+  // If-None-Match takes precedence over If-Modified-Since
+  RequestHeaders both;
+  CHECK(add(both, "If-None-Match", "\"other\""));
+  CHECK(add(both, "If-Modified-Since", DATE));
+  CHECK(!both.isNotModified(ETAG, MODIFIED));
+  RequestHeaders unconditional;
+  CHECK(!unconditional.isNotModified(ETAG, MODIFIED));
+
+  puts("RequestHeaders: headers parsed");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+#include "web/HTTP/Request.h"
+#include "web/HTTP/Router.h"
+#include "web/HTTP/Stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace Ehbanana::Web::HTTP;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+static std::string received;
+
+/**
+ * @brief Receive a fragment of the body of the routed request
+ *
+ * @param data of the fragment
+ * @param length of data
+ * @return ResultCode_t error code
+ */
+static ResultCode_t EHBANANA_CALLBACK bodyProcess(
+    EBStream_t, const void * data, size_t length) {
+  received.append(static_cast<const char *>(data), length);
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Produce the response of the routed request
+ *
+ * @return ResultCode_t error code
+ */
+static ResultCode_t EHBANANA_CALLBACK process(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Parse a request in fragments of a size
+ *
+ * @param router of the request
+ * @param request to parse into
+ * @param string of the request and the bytes after it
+ * @param step size of the fragments
+ * @param rest after the request to return
+ * @return Result error code of the last fragment
+ */
+static Result parse(const Router & router, Request & request,
+    const std::string & string, size_t step, std::string & rest) {
+  const uint8_t * begin = reinterpret_cast<const uint8_t *>(string.data());
+  const uint8_t * end   = begin + string.size();
+  Result          result;
+  received.clear();
+  while (begin != end) {
+    const uint8_t * fragmentEnd = begin + std::min(step, size_t(end - begin));
+    result                      = request.parse(begin, fragmentEnd);
+    if (result != ResultCode_t::INCOMPLETE)
+      break;
+  }
+  rest.assign(begin, end);
+  return result;
+}
+
+int main() {
+  Router router;
+  CHECK(router.addRoute("POST", "/upload", {process, bodyProcess}));
+  std::string rest;
+
+  // Decoded in every fragment size, the bytes after the trailer are the next
+  // request. Chunked takes precedence over Content-Length
+  const std::string NEXT    = "GET / HTTP/1.1\r\n\r\n";
+  const std::string CHUNKED = "POST /upload HTTP/1.1\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "Content-Length: 3\r\n"
+                              "\r\n"
+                              "5\r\nhello\r\n"
+                              "6;name=value\r\n world\r\n"
+                              "0\r\n"
+                              "Trailer-Field: value\r\n"
+                              "\r\n" +
+                              NEXT;
+  for (size_t step = 1; step <= CHUNKED.size(); ++step) {
+    Request request(&router);
+    CHECK(parse(router, request, CHUNKED, step, rest));
+    CHECK(!request.isBodyRejected());
+    CHECK(received == "hello world");
+    CHECK(rest == NEXT);
+  }
+
+  // Another coding is rejected before its body is read
+  Request notSupported(&router);
+  CHECK(parse(router, notSupported,
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+      "1f\r\nGET /smuggled HTTP/1.1\r\n\r\n",
+      1024, rest));
+  CHECK(notSupported.isBodyNotSupported());
+
+  // The chunks are limited to the largest body accepted in total
+  Body::setLimits(8, 4);
+  Request tooLarge(&router);
+  CHECK(parse(router, tooLarge,
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n"
+      "5\r\nhello\r\n4\r\nabcd\r\n0\r\n\r\n",
+      1024, rest));
+  CHECK(tooLarge.isBodyTooLarge());
+  CHECK(received == "hello");
+
+  // Malformed chunks fail the request
+  Request badSize(&router);
+  CHECK(!parse(router, badSize,
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 1024,
+      rest));
+  Request badEnd(&router);
+  CHECK(!parse(router, badEnd,
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+      "2\r\nabc\r\n",
+      1024, rest));
+
+  // A malformed Content-Length fails the request, answered with 400
+  Request badLength(&router);
+  CHECK(parse(router, badLength,
+            "POST /upload HTTP/1.1\r\nContent-Length: -5\r\n\r\n", 1024,
+            rest) == ResultCode_t::INVALID_DATA);
+
+  puts("Request: chunked bodies decoded");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "web/HTTP/Router.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace Ehbanana::Web::HTTP;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief Processes told apart by their address
+ *
+ * @return ResultCode_t error code
+ */
+static ResultCode_t EHBANANA_CALLBACK root(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+static ResultCode_t EHBANANA_CALLBACK api(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+static ResultCode_t EHBANANA_CALLBACK apiUsers(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+static ResultCode_t EHBANANA_CALLBACK exact(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+static ResultCode_t EHBANANA_CALLBACK replaced(EBStream_t) {
+  return ResultCode_t::SUCCESS;
+}
+
+/**
+ * @brief Receive a fragment of a body
+ *
+ * @return ResultCode_t error code
+ */
+static ResultCode_t EHBANANA_CALLBACK body(EBStream_t, const void *, size_t) {
+  return ResultCode_t::SUCCESS;
+}
+
+int main() {
+  Router router;
+  CHECK(router.getRoute("GET", "/").process == nullptr);
+
+  // Only absolute prefixes of supported methods with a process are routed
+  CHECK(router.addRoute("PATCH", "/api", {api}) == ResultCode_t::NOT_SUPPORTED);
+  CHECK(router.addRoute("GET", "api", {api}) == ResultCode_t::INVALID_DATA);
+  CHECK(router.addRoute("GET", "", {api}) == ResultCode_t::INVALID_DATA);
+  CHECK(router.addRoute("GET", "/api", {}) == ResultCode_t::INVALID_DATA);
+
+  CHECK(router.addRoute("GET", "/api", {api}));
+  CHECK(router.addRoute("GET", "/api/users", {apiUsers}));
+  CHECK(router.addRoute("GET", "/api/users", {exact}, true));
+
+  // The longest matching prefix wins, an exact route only the whole URI
+  CHECK(router.getRoute("GET", "/api").process == api);
+  CHECK(router.getRoute("GET", "/api/").process == api);
+  CHECK(router.getRoute("GET", "/api/user").process == api);
+  CHECK(router.getRoute("GET", "/api/users").process == exact);
+  CHECK(router.getRoute("GET", "/api/users/").process == apiUsers);
+  CHECK(router.getRoute("GET", "/api/users/42").process == apiUsers);
+  CHECK(router.getRoute("GET", "/ap").process == nullptr);
+  CHECK(router.getRoute("GET", "/other").process == nullptr);
+  CHECK(router.getRoute("GET", "").process == nullptr);
+
+  // Prefixes match characters, not path segments
+  CHECK(router.getRoute("GET", "/apiary").process == api);
+
+  // Routes are per method
+  CHECK(router.getRoute("POST", "/api").process == nullptr);
+  CHECK(router.addRoute("POST", "/api", {api, body}));
+  CHECK(router.getRoute("POST", "/api/users").process == api);
+  CHECK(router.getRoute("POST", "/api/users").body == body);
+  CHECK(router.getRoute("GET", "/api").body == nullptr);
+
+  // A root prefix catches every URI without a longer match
+  CHECK(router.addRoute("GET", "/", {root}));
+  CHECK(router.getRoute("GET", "/other").process == root);
+  CHECK(router.getRoute("GET", "/api/users/42").process == apiUsers);
+
+  // Registering the same route again replaces its processes only
+  CHECK(router.addRoute("GET", "/api", {replaced}));
+  CHECK(router.getRoute("GET", "/api/user").process == replaced);
+  CHECK(router.getRoute("GET", "/api/users/42").process == apiUsers);
+  CHECK(router.getRoute("GET", "/api/users").process == exact);
+  CHECK(router.addRoute("GET", "/api/users", {replaced}, true));
+  CHECK(router.getRoute("GET", "/api/users").process == replaced);
+  CHECK(router.getRoute("GET", "/api/users/42").process == apiUsers);
+
+  // Each router has its own routes
+  Router other;
+  CHECK(other.getRoute("GET", "/api").process == nullptr);
+
+  puts("Router: routes matched");
+  return EXIT_SUCCESS;
+}
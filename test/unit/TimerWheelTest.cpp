@@ -0,0 +1,104 @@
+#include "web/TimerWheel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using namespace Ehbanana::Web;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+typedef std::chrono::steady_clock Clock_t;
+typedef std::chrono::milliseconds Milliseconds_t;
+
+static Clock_t::time_point start;
+static std::string         fired;
+
+/**
+ * @brief Check a timer expired no earlier than its timeout, and not much later
+ *
+ * @param timeout the timer was scheduled with
+ */
+static void checkElapsed(Milliseconds_t timeout) {
+  Clock_t::duration elapsed = Clock_t::now() - start;
+  CHECK(elapsed >= timeout);
+  CHECK(elapsed < timeout + Milliseconds_t(250));
+}
+
+int main() {
+  asio::io_context ioContext;
+  TimerWheel       wheel(ioContext);
+
+  // Timers past the lowest level's 64 ticks cascade down before expiring
+  TimerWheel::Timer soon([]() {
+    checkElapsed(Milliseconds_t(20));
+    fired += 'a';
+  });
+  TimerWheel::Timer later([]() {
+    checkElapsed(Milliseconds_t(300));
+    fired += 'b';
+  });
+  TimerWheel::Timer cascaded([]() {
+    checkElapsed(Milliseconds_t(900));
+    fired += 'c';
+  });
+  TimerWheel::Timer cancelled([]() { fired += 'x'; });
+  TimerWheel::Timer cancelledByOther([]() { fired += 'y'; });
+  TimerWheel::Timer canceller([&]() {
+    cancelledByOther.cancel();
+    fired += 'd';
+  });
+  TimerWheel::Timer rescheduled([]() {
+    checkElapsed(Milliseconds_t(500));
+    fired += 'e';
+  });
+
+  start = Clock_t::now();
+  wheel.schedule(cascaded, Milliseconds_t(900));
+  wheel.schedule(later, Milliseconds_t(300));
+  wheel.schedule(soon, Milliseconds_t(20));
+  wheel.schedule(cancelled, Milliseconds_t(40));
+  wheel.schedule(canceller, Milliseconds_t(100));
+  wheel.schedule(cancelledByOther, Milliseconds_t(800));
+  wheel.schedule(rescheduled, Milliseconds_t(60));
+  // Scheduling a pending timer again replaces its expiry
+  wheel.schedule(rescheduled, Milliseconds_t(500));
+  CHECK(cancelled.isPending());
+  cancelled.cancel();
+  CHECK(!cancelled.isPending());
+  cancelled.cancel();
+
+  // A timer may destroy itself from its callback
+  TimerWheel::Timer * once = nullptr;
+  once = new TimerWheel::Timer([&]() {
+    delete once;
+    once = nullptr;
+    fired += 'f';
+  });
+  wheel.schedule(*once, Milliseconds_t(700));
+
+  // Runs until no timers are pending
+  ioContext.run();
+  CHECK(fired == "adbefc");
+  CHECK(!soon.isPending() && !cascaded.isPending());
+  CHECK(!cancelledByOther.isPending());
+  CHECK(once == nullptr);
+
+  // A timer destroyed while pending never fires
+  {
+    TimerWheel::Timer dropped([]() { fired += 'z'; });
+    wheel.schedule(dropped, Milliseconds_t(10));
+  }
+  ioContext.restart();
+  ioContext.run();
+  CHECK(fired == "adbefc");
+
+  puts("TimerWheel: timers expired in order");
+  return EXIT_SUCCESS;
+}